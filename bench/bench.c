@@ -0,0 +1,425 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * End-to-end benchmark suite. Runs a fixed set of evolution jobs with fixed
+ * seeds, reports throughput and time-to-solution for each, and optionally
+ * compares the results against a stored baseline file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "portable_getopt.h"
+#include "evolution.h"
+#include "common.h"
+
+#define MAX_JOB_TESTCASES       (8u)
+#define MAX_NAME_SIZE           (32u)
+
+#define DEFAULT_THRESHOLD       (15.0)
+
+#define BENCH_MAX_LEN           (1024u)
+#define BENCH_OPTGENS           (200)
+
+
+/**
+ * A single benchmark job
+ */
+typedef struct
+{
+    // Name used to identify this job in reports and baseline files
+    const char *name;
+
+    // Test cases in the same format as bfintern command-line arguments, NULL terminated
+    const char *testcases[MAX_JOB_TESTCASES + 1u];
+
+    // Seed passed to pcg32_seed
+    unsigned int seed;
+
+    uint32_t population_size;
+
+    // Evolution is stopped after this many generations if not finished
+    uint32_t max_generations;
+} bench_job_t;
+
+
+/**
+ * Results from a single benchmark job
+ */
+typedef struct
+{
+    char name[MAX_NAME_SIZE];
+    double programs_per_sec;
+    uint64_t first_solution_ms;
+    uint64_t final_program_ms;
+    uint64_t total_ms;
+    uint32_t num_generations;
+    size_t program_len;
+} bench_result_t;
+
+
+static const bench_job_t _jobs[] =
+{
+    {"short_string",  {"Hi", NULL},                                   1u, 1024u, 1500u},
+    {"long_string",   {"aaaaabbbbbcccccdddddeeeeefffffggggg", NULL},  1u, 1024u, 3000u},
+    {"echo",          {"a:a", "b:b", "z:z", NULL},                    1u, 1024u, 1500u},
+    {"increment",     {"a:b", "c:d", "x:y", NULL},                    1u, 1024u, 1500u},
+    {"bool_strings",  {"0:bool 0", "1:bool 1", NULL},                 1u, 1024u, 3000u},
+};
+
+#define NUM_JOBS (sizeof(_jobs) / sizeof(_jobs[0]))
+
+
+static evolution_testcase_t _testcases[MAX_JOB_TESTCASES];
+static bench_result_t _results[NUM_JOBS];
+
+
+static void help_text(char *arg0)
+{
+    printf("\nUsage: %s [OPTIONS]\n\n", arg0);
+
+    printf("Runs a fixed set of evolution jobs with fixed seeds, and reports\n"
+           "programs per second, time to first solution, and time to final\n"
+           "program length for each job.\n\n");
+
+    printf("OPTIONS:\n\n");
+    printf("-b <file>          Compare results against baseline file <file>, and\n"
+           "                   exit with a non-zero status if any job regressed.\n\n");
+
+    printf("-w <file>          Write results to <file>, for use as a baseline.\n\n");
+
+    printf("-t <percent>       Regression threshold, in percent. Default is %.1f.\n\n",
+           DEFAULT_THRESHOLD);
+
+    printf("-h                 Show this text and exit.\n\n");
+}
+
+// Populate _testcases from a NULL-terminated list of test case strings
+static unsigned int _load_testcases(const char * const *strs)
+{
+    unsigned int count = 0u;
+
+    for (; (NULL != strs[count]) && (count < MAX_JOB_TESTCASES); count++)
+    {
+        evolution_testcase_t *testcase = &_testcases[count];
+        const char *str = strs[count];
+        const char *colon = strchr(str, ':');
+
+        testcase->input = str;
+
+        if (NULL == colon)
+        {
+            testcase->input_size = 0u;
+        }
+        else
+        {
+            testcase->input_size = colon - str;
+            str = colon + 1;
+        }
+
+        testcase->output = str;
+        testcase->output_size = strlen(str);
+    }
+
+    return count;
+}
+
+static int _run_job(const bench_job_t *job, bench_result_t *result)
+{
+    evolution_config_t config =
+    {
+        .elitism = 0.5f,
+        .crossover = 0.5f,
+        .mutation = 1.0f,
+        .population_size = job->population_size,
+        .max_program_size = BENCH_MAX_LEN,
+        .num_optimization_gens = BENCH_OPTGENS,
+        .max_generations = job->max_generations,
+        .selection = SELECTION_TOURNAMENT,
+        .fitness = FITNESS_POSITIONAL,
+        .stagnation_policy = STAGNATION_HYPERMUTATE,
+        .quiet = true,
+        .telemetry_fd = -1,
+        .telemetry_interval = 1u,
+    };
+
+    size_t output_size = sizeof(evolution_output_t) + BENCH_MAX_LEN + 1u;
+    evolution_output_t *output = malloc(output_size);
+    if (NULL == output)
+    {
+        bfi_log("Failed to allocate %zu bytes", output_size);
+        return -1;
+    }
+
+    unsigned int num_testcases = _load_testcases(job->testcases);
+
+    pcg32_seed(job->seed);
+
+    uint64_t start_ms = ms_since_epoch();
+    int ret = evolve_bf_program(_testcases, num_testcases, &config, output);
+    uint64_t total_ms = ms_since_epoch() - start_ms;
+
+    if (0 == ret)
+    {
+        snprintf(result->name, sizeof(result->name), "%s", job->name);
+        result->total_ms = total_ms;
+        result->programs_per_sec = ((double) output->num_bf_programs * 1000.0) /
+                                   ((double) MAX_VAL(total_ms, 1u));
+        result->first_solution_ms = output->first_solution_ms;
+        result->final_program_ms = output->final_program_ms;
+        result->num_generations = output->num_generations;
+        result->program_len = strlen(output->bf_program);
+    }
+
+    free(output);
+    return ret;
+}
+
+// Format a time value, which may be EVOLUTION_NO_TIME
+static void _fmt_ms(uint64_t ms, char *buf, size_t bufsize)
+{
+    if (EVOLUTION_NO_TIME == ms)
+    {
+        snprintf(buf, bufsize, "-");
+    }
+    else
+    {
+        snprintf(buf, bufsize, "%"PRIu64, ms);
+    }
+}
+
+static void _print_result(const bench_result_t *result)
+{
+    char first[32];
+    char final[32];
+
+    _fmt_ms(result->first_solution_ms, first, sizeof(first));
+    _fmt_ms(result->final_program_ms, final, sizeof(final));
+
+    printf("%-16s %12.0f %12s %12s %10"PRIu64" %8u %8zu\n", result->name,
+           result->programs_per_sec, first, final, result->total_ms,
+           result->num_generations, result->program_len);
+}
+
+static int _write_baseline(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (NULL == fp)
+    {
+        bfi_log("Failed to open %s for writing", path);
+        return -1;
+    }
+
+    fprintf(fp, "# name programs_per_sec first_solution_ms final_program_ms\n");
+
+    for (unsigned int i = 0u; i < NUM_JOBS; i++)
+    {
+        char first[32];
+        char final[32];
+
+        _fmt_ms(_results[i].first_solution_ms, first, sizeof(first));
+        _fmt_ms(_results[i].final_program_ms, final, sizeof(final));
+
+        fprintf(fp, "%s %.0f %s %s\n", _results[i].name, _results[i].programs_per_sec,
+                first, final);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+// Parse a time value written by _fmt_ms
+static uint64_t _parse_ms(const char *str)
+{
+    if (0 == strcmp(str, "-"))
+    {
+        return EVOLUTION_NO_TIME;
+    }
+
+    return strtoull(str, NULL, 10);
+}
+
+// Returns true if time 'ms' is a regression from baseline time 'base_ms'
+static bool _time_regressed(uint64_t ms, uint64_t base_ms, double threshold)
+{
+    if (EVOLUTION_NO_TIME == base_ms)
+    {
+        return false;
+    }
+
+    if (EVOLUTION_NO_TIME == ms)
+    {
+        return true;
+    }
+
+    return ((double) ms) > (((double) base_ms) * (1.0 + (threshold / 100.0)));
+}
+
+static int _compare_baseline(const char *path, double threshold, unsigned int *num_regressions)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp)
+    {
+        bfi_log("Failed to open %s for reading", path);
+        return -1;
+    }
+
+    char line[256];
+
+    *num_regressions = 0u;
+
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        char name[MAX_NAME_SIZE];
+        char first[32];
+        char final[32];
+        double base_pps;
+
+        if (('#' == line[0]) ||
+            (4 != sscanf(line, "%31s %lf %31s %31s", name, &base_pps, first, final)))
+        {
+            continue;
+        }
+
+        const bench_result_t *result = NULL;
+        for (unsigned int i = 0u; i < NUM_JOBS; i++)
+        {
+            if (0 == strcmp(_results[i].name, name))
+            {
+                result = &_results[i];
+                break;
+            }
+        }
+
+        if (NULL == result)
+        {
+            printf("%-16s not in this benchmark suite, skipping\n", name);
+            continue;
+        }
+
+        double pps_change = ((result->programs_per_sec - base_pps) / base_pps) * 100.0;
+        bool regressed = false;
+
+        if (pps_change < -threshold)
+        {
+            printf("%-16s REGRESSION: programs/sec %.0f -> %.0f (%+.1f%%)\n", name,
+                   base_pps, result->programs_per_sec, pps_change);
+            regressed = true;
+        }
+
+        uint64_t base_first = _parse_ms(first);
+        if (_time_regressed(result->first_solution_ms, base_first, threshold))
+        {
+            printf("%-16s REGRESSION: time to first solution %s -> %"PRIu64" ms\n", name,
+                   first, result->first_solution_ms);
+            regressed = true;
+        }
+
+        uint64_t base_final = _parse_ms(final);
+        if (_time_regressed(result->final_program_ms, base_final, threshold))
+        {
+            printf("%-16s REGRESSION: time to final length %s -> %"PRIu64" ms\n", name,
+                   final, result->final_program_ms);
+            regressed = true;
+        }
+
+        if (regressed)
+        {
+            (*num_regressions)++;
+        }
+        else
+        {
+            printf("%-16s ok (programs/sec %+.1f%%)\n", name, pps_change);
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *baseline_path = NULL;
+    const char *write_path = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    char c;
+
+    while ((c = portable_getopt(argc, argv, "hb:w:t:")) != -1)
+    {
+        switch (c)
+        {
+            case 'b':
+                baseline_path = optarg;
+                break;
+
+            case 'w':
+                write_path = optarg;
+                break;
+
+            case 't':
+            {
+                char *endptr;
+                threshold = strtod(optarg, &endptr);
+                if ((endptr == optarg) || (threshold < 0.0))
+                {
+                    bfi_log("Invalid value provided for -t option, expected a positive number");
+                    return -1;
+                }
+                break;
+            }
+
+            case 'h':
+            default:
+                help_text(argv[0]);
+                return -1;
+        }
+    }
+
+    printf("%-16s %12s %12s %12s %10s %8s %8s\n", "job", "programs/s", "first_ms",
+           "final_ms", "total_ms", "gens", "length");
+
+    for (unsigned int i = 0u; i < NUM_JOBS; i++)
+    {
+        if (_run_job(&_jobs[i], &_results[i]) < 0)
+        {
+            bfi_log("Job %s failed", _jobs[i].name);
+            return -1;
+        }
+
+        _print_result(&_results[i]);
+        fflush(stdout);
+    }
+
+    if (NULL != write_path)
+    {
+        if (_write_baseline(write_path) < 0)
+        {
+            return -1;
+        }
+
+        printf("\nwrote results to %s\n", write_path);
+    }
+
+    if (NULL != baseline_path)
+    {
+        unsigned int num_regressions;
+
+        printf("\ncomparing against %s (threshold %.1f%%)\n\n", baseline_path, threshold);
+        if (_compare_baseline(baseline_path, threshold, &num_regressions) < 0)
+        {
+            return -1;
+        }
+
+        if (0u < num_regressions)
+        {
+            printf("\n%u job(s) regressed\n", num_regressions);
+            return 1;
+        }
+    }
+
+    return 0;
+}
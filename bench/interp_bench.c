@@ -0,0 +1,294 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Interpreter microbenchmark. Runs bf_interpret alone over a recorded corpus of
+ * evolved BF programs, and reports time per program and instructions per second,
+ * broken down by how each program terminated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "portable_getopt.h"
+#include "bf_utils.h"
+#include "common.h"
+
+#define DEFAULT_CORPUS          ("bench/corpus.txt")
+#define DEFAULT_REPS            (200u)
+
+// Each category is run repeatedly for at least this long, so that categories
+// with few or very short programs are still timed accurately
+#define MIN_CATEGORY_MS         (250u)
+
+// Same output limit that is used when assessing programs during evolution
+#define MAX_OUTPUT_SIZE         (128u)
+
+// Successful programs that execute at least this many instructions are
+// considered long-running
+#define LONG_RUNNING_INSTRUCTIONS (100)
+
+#define MAX_LINE_SIZE           (8192u)
+
+
+/**
+ * Enumerates categories that corpus programs are sorted into
+ */
+typedef enum
+{
+    CATEGORY_VALID = 0,
+    CATEGORY_LONG_RUNNING,
+    CATEGORY_INVALID,
+    CATEGORY_TIMEOUT,
+    NUM_CATEGORIES
+} category_e;
+
+
+/**
+ * A single corpus entry
+ */
+typedef struct
+{
+    char *input;
+    size_t input_len;
+    char *program;
+    category_e category;
+} corpus_entry_t;
+
+
+static const char *_category_names[NUM_CATEGORIES] =
+{
+    "valid", "long_running", "invalid", "timeout"
+};
+
+static corpus_entry_t *_corpus = NULL;
+static unsigned int _corpus_size = 0u;
+
+
+static void help_text(char *arg0)
+{
+    printf("\nUsage: %s [OPTIONS]\n\n", arg0);
+
+    printf("Runs the BF interpreter over a corpus of recorded BF programs, and\n"
+           "reports nanoseconds per program and instructions per second, for\n"
+           "each category of program (valid, long-running, invalid, timeout).\n\n");
+
+    printf("OPTIONS:\n\n");
+    printf("-c <file>          Corpus file to load. Each line contains input data,\n"
+           "                   a tab character, and a BF program. Default is %s.\n\n",
+           DEFAULT_CORPUS);
+
+    printf("-n <num>           Minimum number of times to run each program. More\n"
+           "                   runs are added until each category has run for at\n"
+           "                   least %u ms. Default is %u.\n\n",
+           MIN_CATEGORY_MS, DEFAULT_REPS);
+
+    printf("-h                 Show this text and exit.\n\n");
+}
+
+// Run a single corpus entry once, and return the instruction count
+static int _run_entry(corpus_entry_t *entry, int *ret)
+{
+    char output[MAX_OUTPUT_SIZE];
+
+    *ret = bf_interpret(entry->program, entry->input, entry->input_len, output,
+                        MAX_OUTPUT_SIZE - 1u, MAX_INSTRUCTIONS_EXEC);
+
+    return bf_last_instruction_count();
+}
+
+static int _load_corpus(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp)
+    {
+        bfi_log("Failed to open %s for reading", path);
+        return -1;
+    }
+
+    char *line = malloc(MAX_LINE_SIZE);
+    unsigned int capacity = 0u;
+
+    if (NULL == line)
+    {
+        fclose(fp);
+        return -1;
+    }
+
+    while (NULL != fgets(line, MAX_LINE_SIZE, fp))
+    {
+        char *tab = strchr(line, '\t');
+
+        if (('#' == line[0]) || (NULL == tab))
+        {
+            continue;
+        }
+
+        line[strcspn(line, "\r\n")] = 0;
+
+        if (_corpus_size == capacity)
+        {
+            capacity = (0u == capacity) ? 256u : capacity * 2u;
+            corpus_entry_t *corpus = realloc(_corpus, capacity * sizeof(corpus_entry_t));
+            if (NULL == corpus)
+            {
+                bfi_log("Failed to allocate memory");
+                free(line);
+                fclose(fp);
+                return -1;
+            }
+
+            _corpus = corpus;
+        }
+
+        corpus_entry_t *entry = &_corpus[_corpus_size];
+
+        *tab = 0;
+        entry->input_len = tab - line;
+        entry->input = malloc(entry->input_len + 1u);
+        entry->program = malloc(strlen(tab + 1) + 1u);
+
+        if ((NULL == entry->input) || (NULL == entry->program))
+        {
+            bfi_log("Failed to allocate memory");
+            free(line);
+            fclose(fp);
+            return -1;
+        }
+
+        memcpy(entry->input, line, entry->input_len + 1u);
+        strcpy(entry->program, tab + 1);
+
+        // Categorize by running the program once
+        int ret;
+        int instructions = _run_entry(entry, &ret);
+
+        if (BF_ERR_INVALID == ret)
+        {
+            entry->category = CATEGORY_INVALID;
+        }
+        else if (BF_ERR_TIMEOUT == ret)
+        {
+            entry->category = CATEGORY_TIMEOUT;
+        }
+        else if (LONG_RUNNING_INSTRUCTIONS <= instructions)
+        {
+            entry->category = CATEGORY_LONG_RUNNING;
+        }
+        else
+        {
+            entry->category = CATEGORY_VALID;
+        }
+
+        _corpus_size++;
+    }
+
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *corpus_path = DEFAULT_CORPUS;
+    unsigned int reps = DEFAULT_REPS;
+    char c;
+
+    while ((c = portable_getopt(argc, argv, "hc:n:")) != -1)
+    {
+        switch (c)
+        {
+            case 'c':
+                corpus_path = optarg;
+                break;
+
+            case 'n':
+            {
+                long int val = strtol(optarg, NULL, 10);
+                if (val <= 0)
+                {
+                    bfi_log("Invalid value provided for -n option, must be 1 or greater");
+                    return -1;
+                }
+
+                reps = (unsigned int) val;
+                break;
+            }
+
+            case 'h':
+            default:
+                help_text(argv[0]);
+                return -1;
+        }
+    }
+
+    if (_load_corpus(corpus_path) < 0)
+    {
+        return -1;
+    }
+
+    printf("%u programs loaded from %s, at least %u runs each\n\n", _corpus_size,
+           corpus_path, reps);
+    printf("%-14s %8s %14s %14s %16s\n", "category", "programs", "ns/program",
+           "instr/program", "instr/sec");
+
+    // Time and instructions for a single run of every program in the corpus, summed
+    // over categories, since each category may be repeated a different number of times
+    double pass_ns = 0.0;
+    double pass_instructions = 0.0;
+
+    for (unsigned int cat = 0u; cat < NUM_CATEGORIES; cat++)
+    {
+        unsigned int count = 0u;
+        uint64_t instructions = 0u;
+
+        for (unsigned int i = 0u; i < _corpus_size; i++)
+        {
+            count += (cat == _corpus[i].category);
+        }
+
+        if (0u == count)
+        {
+            printf("%-14s %8u %14s %14s %16s\n", _category_names[cat], count, "-", "-", "-");
+            continue;
+        }
+
+        uint64_t start_ns = monotonic_ns();
+        uint64_t elapsed_ns = 0u;
+        unsigned int cat_reps = 0u;
+
+        while ((cat_reps < reps) || (elapsed_ns < (MIN_CATEGORY_MS * 1000000ULL)))
+        {
+            for (unsigned int i = 0u; i < _corpus_size; i++)
+            {
+                if (cat == _corpus[i].category)
+                {
+                    int ret;
+                    instructions += _run_entry(&_corpus[i], &ret);
+                }
+            }
+
+            cat_reps++;
+            elapsed_ns = monotonic_ns() - start_ns;
+        }
+
+        double runs = ((double) count) * ((double) cat_reps);
+        double elapsed_s = ((double) MAX_VAL(elapsed_ns, 1u)) / 1e9;
+
+        pass_ns += ((double) elapsed_ns) / ((double) cat_reps);
+        pass_instructions += ((double) instructions) / ((double) cat_reps);
+
+        printf("%-14s %8u %14.1f %14.1f %16.0f\n", _category_names[cat], count,
+               (elapsed_s * 1e9) / runs, ((double) instructions) / runs,
+               ((double) instructions) / elapsed_s);
+    }
+
+    printf("%-14s %8u %14.1f %14.1f %16.0f\n", "all", _corpus_size,
+           pass_ns / ((double) MAX_VAL(_corpus_size, 1u)),
+           pass_instructions / ((double) MAX_VAL(_corpus_size, 1u)),
+           (pass_instructions * 1e9) / MAX_VAL(pass_ns, 1.0));
+
+    return 0;
+}
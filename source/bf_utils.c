@@ -9,7 +9,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include "common.h"
+#include "bf_utils.h"
 
 #define TAPE_SIZE  300000
 
@@ -21,9 +23,25 @@
 
 static int stack[STACK_SIZE];
 
+/* Tape is only ever non-zero between calls to bf_interpret_ex, so only the part
+ * that a program could have written to needs to be cleared afterwards */
+static unsigned char tape[TAPE_SIZE];
+
+// Highest tape index that the data pointer has been moved to by the current program
+static int tape_hi;
+
 static unsigned int pos;
 static const char *syms = "+-<>.[],";
 
+// Number of instructions executed by the last call to bf_interpret
+static int _last_instructions = 0;
+
+// Number of input characters read by the last call to bf_interpret
+static int _last_input = 0;
+
+// Location to record the index of the '.' that printed each output character, if not NULL
+static int *_output_trace = NULL;
+
 #define stack_pop() ((pos == 0) ? -1 : stack[--pos])
 #define stack_peek() ((pos == 0) ? -1 : stack[pos - 1])
 
@@ -40,6 +58,40 @@ static int stack_push(int val)
 }
 
 
+// Return from _interpret, saving the number of instructions executed
+#define INTERPRET_EXIT(ret)         \
+    do                              \
+    {                               \
+        _last_instructions = ep;    \
+        _last_input = in;           \
+        *pointer = p;               \
+        return (ret);               \
+    } while (0)
+
+/**
+ * @see bf_utils.h
+ */
+void bf_trace_output(int *trace)
+{
+    _output_trace = trace;
+}
+
+/**
+ * @see bf_utils.h
+ */
+int bf_last_instruction_count(void)
+{
+    return _last_instructions;
+}
+
+/**
+ * @see bf_utils.h
+ */
+int bf_last_input_count(void)
+{
+    return _last_input;
+}
+
 /**
  * @see bf_utils.h
  */
@@ -48,6 +100,39 @@ char bf_rand_sym(void)
     return syms[pcg32_rand() % BF_NUM_SYMS];
 }
 
+/**
+ * @see bf_utils.h
+ */
+int bf_print_program(const char *text, size_t text_len, char *program, size_t max_len)
+{
+    unsigned char cell = 0u;
+    size_t len = 0u;
+
+    for (size_t i = 0u; i < text_len; i++)
+    {
+        unsigned char diff = ((unsigned char) text[i]) - cell;
+
+        // Only subtract if the cell doesn't have to wrap around zero, since
+        // bf_interpret doesn't wrap decrements the same way as increments
+        bool down = (diff > 128u) && ((256u - diff) <= cell);
+        char sym = down ? '-' : '+';
+        size_t count = down ? (256u - diff) : diff;
+
+        if ((len + count + 1u) > max_len)
+        {
+            return -1;
+        }
+
+        memset(program + len, sym, count);
+        len += count;
+        program[len++] = '.';
+        cell = (unsigned char) text[i];
+    }
+
+    program[len] = 0;
+    return (int) len;
+}
+
 /**
  * @see bf_utils.h
  */
@@ -87,7 +172,7 @@ int bf_rand_syms(char *output, int min_size, int max_size)
  *           duplicates after
  * @return  number of duplicates after first character
  */
-static int count_dupes_ahead(char *s)
+static int count_dupes_ahead(const char *s)
 {
     int i;
 
@@ -102,14 +187,10 @@ static int count_dupes_ahead(char *s)
     return i - 1;
 }
 
-/**
- * @see bf_utils.h
- */
-int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t max_output,
-                 int max_instructions)
+// Interpret a BF program on the current tape, starting at data pointer 'p'
+static int _interpret(char *prog, const char *input, size_t input_len, char *output, size_t max_output,
+                      int max_instructions, int p, int *pointer)
 {
-    unsigned char tape[TAPE_SIZE];
-
     int depth = 0;
 
     /* No. of instructions executed */
@@ -118,9 +199,6 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
     /* Index of current instruction */
     int i;
 
-    /* Index to current instruction in program */
-    int p = 0;
-
     /* Index to current position in output buffer */
     int out = 0;
 
@@ -129,14 +207,13 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
 
     int dupes;
 
-    memset(tape, 0, TAPE_SIZE);
     pos = 0;
 
     for(i = 0, ep = 0; prog[i]; i++, ep++)
     {
         if (ep >= max_instructions)
         {
-            return -1;
+            INTERPRET_EXIT(BF_ERR_TIMEOUT);
         }
 
         switch (prog[i])
@@ -145,7 +222,7 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
             {
                 if (!index_valid(p))
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 dupes = count_dupes_ahead(prog + i);
@@ -157,7 +234,7 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
             {
                 if (!index_valid(p))
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 dupes = count_dupes_ahead(prog + i);
@@ -185,18 +262,28 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
                 dupes = count_dupes_ahead(prog + i);
                 p += (dupes + 1);
                 i += dupes;
+
+                if (p > tape_hi)
+                {
+                    tape_hi = p;
+                }
                 break;
             }
             case '.':
             {
                 if (!index_valid(p))
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 if (out >= max_output)
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_TIMEOUT);
+                }
+
+                if (NULL != _output_trace)
+                {
+                    _output_trace[out] = i;
                 }
 
                 output[out++] = tape[p];
@@ -206,12 +293,12 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
             {
                 if (!index_valid(p))
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 if (in >= input_len)
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 tape[p] = input[in++];
@@ -221,7 +308,7 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
             {
                 if (!index_valid(p))
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 if (tape[p])
@@ -229,12 +316,12 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
                     // Ignore obvious infinite loops
                     if (prog[i + 1] == ']')
                     {
-                        return -1;
+                        INTERPRET_EXIT(BF_ERR_TIMEOUT);
                     }
 
                     if (stack_push(i) < 0)
                     {
-                        return -1;
+                        INTERPRET_EXIT(BF_ERR_INVALID);
                     }
 
                     depth++;
@@ -250,7 +337,7 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
 
                         if (!prog[i])
                         {
-                            return -1;
+                            INTERPRET_EXIT(BF_ERR_INVALID);
                         }
 
                         if (prog[i] == ']')
@@ -270,12 +357,12 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
             {
                 if (!index_valid(p))
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 if (depth <= 0)
                 {
-                    return -1;
+                    INTERPRET_EXIT(BF_ERR_INVALID);
                 }
 
                 if (tape[p])
@@ -284,7 +371,7 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
 
                     if ((start = stack_peek()) < 0)
                     {
-                        return -1;
+                        INTERPRET_EXIT(BF_ERR_INVALID);
                     }
 
                     i = start;
@@ -302,7 +389,159 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
 
     if (depth != 0)
     {
-        return -1;
+        INTERPRET_EXIT(BF_ERR_INVALID);
+    }
+
+    if (out > 0)
+    {
+        output[out] = 0;
+    }
+
+    INTERPRET_EXIT(out);
+}
+
+// Run a compiled BF program on the current tape, starting at data pointer 'p'
+static int _execute(const bf_insn_t *code, int code_len, const char *input, size_t input_len,
+                    char *output, size_t max_output, int max_instructions, int p, int *pointer)
+{
+    /* No. of instructions executed */
+    int ep;
+
+    /* Index of current instruction */
+    int i;
+
+    /* Index to current position in output buffer */
+    int out = 0;
+
+    /* Index to current position in input buffer */
+    int in = 0;
+
+    for (i = 0, ep = 0; i < code_len; i++, ep++)
+    {
+        if (ep >= max_instructions)
+        {
+            INTERPRET_EXIT(BF_ERR_TIMEOUT);
+        }
+
+        const bf_insn_t *insn = &code[i];
+
+        switch (insn->op)
+        {
+            case '+':
+            {
+                if (!index_valid(p))
+                {
+                    INTERPRET_EXIT(BF_ERR_INVALID);
+                }
+
+                tape[p] = (tape[p] + insn->arg) % 256;
+                break;
+            }
+            case '-':
+            {
+                if (!index_valid(p))
+                {
+                    INTERPRET_EXIT(BF_ERR_INVALID);
+                }
+
+                // Same wraparound as _interpret
+                if (tape[p] < insn->arg)
+                {
+                    tape[p] = 255 - (insn->arg % 256);
+                }
+                else
+                {
+                    tape[p] -= insn->arg;
+                }
+                break;
+            }
+            case '<':
+            {
+                p -= insn->arg;
+                break;
+            }
+            case '>':
+            {
+                p += insn->arg;
+
+                if (p > tape_hi)
+                {
+                    tape_hi = p;
+                }
+                break;
+            }
+            case '.':
+            {
+                if (!index_valid(p))
+                {
+                    INTERPRET_EXIT(BF_ERR_INVALID);
+                }
+
+                if (out >= max_output)
+                {
+                    INTERPRET_EXIT(BF_ERR_TIMEOUT);
+                }
+
+                if (NULL != _output_trace)
+                {
+                    _output_trace[out] = insn->arg;
+                }
+
+                output[out++] = tape[p];
+                break;
+            }
+            case ',':
+            {
+                if (!index_valid(p))
+                {
+                    INTERPRET_EXIT(BF_ERR_INVALID);
+                }
+
+                if (in >= input_len)
+                {
+                    INTERPRET_EXIT(BF_ERR_INVALID);
+                }
+
+                tape[p] = input[in++];
+                break;
+            }
+            case '[':
+            {
+                if (!index_valid(p))
+                {
+                    INTERPRET_EXIT(BF_ERR_INVALID);
+                }
+
+                if (tape[p])
+                {
+                    // Ignore obvious infinite loops
+                    if (code[i + 1].op == ']')
+                    {
+                        INTERPRET_EXIT(BF_ERR_TIMEOUT);
+                    }
+                }
+                else
+                {
+                    i = insn->arg;
+                }
+
+                break;
+            }
+            case ']':
+            {
+                if (!index_valid(p))
+                {
+                    INTERPRET_EXIT(BF_ERR_INVALID);
+                }
+
+                if (tape[p])
+                {
+                    i = insn->arg;
+                }
+
+                break;
+            }
+        }
     }
 
     if (out > 0)
@@ -310,5 +549,152 @@ int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t
         output[out] = 0;
     }
 
-    return out;
+    INTERPRET_EXIT(out);
+}
+
+/**
+ * @see bf_utils.h
+ */
+int bf_compile(const char *prog, bf_insn_t *code, size_t max_code)
+{
+    int len = 0;
+
+    pos = 0;
+
+    for (int i = 0; prog[i]; i++)
+    {
+        if (((size_t) len) >= max_code)
+        {
+            return BF_ERR_INVALID;
+        }
+
+        bf_insn_t *insn = &code[len];
+        insn->op = prog[i];
+        insn->arg = 1;
+
+        switch (prog[i])
+        {
+            case '+':
+            case '-':
+            case '<':
+            case '>':
+            {
+                int dupes = count_dupes_ahead(prog + i);
+                insn->arg += dupes;
+                i += dupes;
+                break;
+            }
+            case '.':
+            {
+                insn->arg = i;
+                break;
+            }
+            case '[':
+            {
+                if (stack_push(len) < 0)
+                {
+                    return BF_ERR_INVALID;
+                }
+                break;
+            }
+            case ']':
+            {
+                int start = stack_pop();
+                if (start < 0)
+                {
+                    return BF_ERR_INVALID;
+                }
+
+                insn->arg = start;
+                code[start].arg = len;
+                break;
+            }
+        }
+
+        len++;
+    }
+
+    return (0u == pos) ? len : BF_ERR_INVALID;
+}
+
+// Load the interpreter state to start from, and return the data pointer
+static int _load_state(const bf_state_t *start)
+{
+    int p = 0;
+
+    tape_hi = 0;
+
+    if (NULL != start)
+    {
+        memcpy(tape, start->tape, start->tape_len);
+        p = start->pointer;
+        tape_hi = MAX_VAL(start->tape_len - 1, p);
+    }
+
+    return p;
+}
+
+// Save the interpreter state left behind by a BF program, and clear the tape
+static int _save_state(int ret, int p, bf_state_t *end)
+{
+    // Nothing past tape_hi can have been written to
+    int dirty = MIN_VAL(tape_hi + 1, TAPE_SIZE);
+
+    if ((0 <= ret) && (NULL != end))
+    {
+        if ((BF_STATE_TAPE_SIZE < dirty) || !index_valid(p))
+        {
+            ret = BF_ERR_INVALID;
+        }
+        else
+        {
+            // Trailing zero cells don't need to be stored
+            end->tape_len = dirty;
+            while ((0 < end->tape_len) && (0u == tape[end->tape_len - 1]))
+            {
+                end->tape_len--;
+            }
+
+            memcpy(end->tape, tape, end->tape_len);
+            end->pointer = p;
+        }
+    }
+
+    memset(tape, 0, dirty);
+
+    return ret;
+}
+
+/**
+ * @see bf_utils.h
+ */
+int bf_interpret_ex(char *prog, const char *input, size_t input_len, char *output, size_t max_output,
+                    int max_instructions, const bf_state_t *start, bf_state_t *end)
+{
+    int p = _load_state(start);
+    int ret = _interpret(prog, input, input_len, output, max_output, max_instructions, p, &p);
+
+    return _save_state(ret, p, end);
+}
+
+/**
+ * @see bf_utils.h
+ */
+int bf_execute_ex(const bf_insn_t *code, int code_len, const char *input, size_t input_len,
+                  char *output, size_t max_output, int max_instructions, const bf_state_t *start,
+                  bf_state_t *end)
+{
+    int p = _load_state(start);
+    int ret = _execute(code, code_len, input, input_len, output, max_output, max_instructions, p, &p);
+
+    return _save_state(ret, p, end);
+}
+
+/**
+ * @see bf_utils.h
+ */
+int bf_interpret(char *prog, const char *input, size_t input_len, char *output, size_t max_output,
+                 int max_instructions)
+{
+    return bf_interpret_ex(prog, input, input_len, output, max_output, max_instructions, NULL, NULL);
 }
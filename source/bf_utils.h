@@ -9,6 +9,54 @@
 #ifndef BF_UTILS_H
 #define BF_UTILS_H
 
+#include <stddef.h>
+
+// bf_interpret return value for a program that is syntactically invalid, or that
+// tried to do something illegal (e.g. move outside the tape, read past the input)
+#define BF_ERR_INVALID (-1)
+
+// bf_interpret return value for a program that exceeded the maximum number of
+// instructions, or the maximum number of output characters
+#define BF_ERR_TIMEOUT (-2)
+
+// If a BF program executes more than this many instructions, it is considered
+// timed out. Used everywhere BF programs are assessed against test cases.
+#define MAX_INSTRUCTIONS_EXEC (10000)
+
+// Max. number of tape cells that can be held by a bf_state_t
+#define BF_STATE_TAPE_SIZE (1024)
+
+
+/**
+ * Holds the tape and data pointer of the BF interpreter, so that a BF program
+ * can continue from where another one left off
+ */
+typedef struct
+{
+    // Tape cells; all cells from tape_len onwards are 0
+    unsigned char tape[BF_STATE_TAPE_SIZE];
+    int tape_len;
+
+    // Index of the current tape cell
+    int pointer;
+} bf_state_t;
+
+
+/**
+ * A single instruction of a compiled BF program
+ */
+typedef struct
+{
+    // BF symbol
+    char op;
+
+    /* For '+', '-', '<' and '>', the number of times the symbol is repeated.
+     * For '[' and ']', the index of the matching bracket. For '.', the index of
+     * the symbol in the BF program it was compiled from. Unused otherwise. */
+    int arg;
+} bf_insn_t;
+
+
 /**
  * Interpret a BF program and place the output (if any) in 'output'
  *
@@ -19,12 +67,97 @@
  * @param  max_output        maximum number of output characters
  * @param  max_instructions  maximum number of instructions to execute.
  *                           0 for infinite.
- * @return -1 if interpretation failed, or max. number of output characters
- *         exceeded, or max. number of instructions exceeded
+ * @return number of output characters if successful, BF_ERR_INVALID if
+ *         interpretation failed, or BF_ERR_TIMEOUT if max. number of output
+ *         characters exceeded or max. number of instructions exceeded
  */
-int bf_interpret(char *prog, char *input, size_t input_len, char *output, size_t max_output,
+int bf_interpret(char *prog, const char *input, size_t input_len, char *output, size_t max_output,
                  int max_instructions);
 
+/**
+ * Same as bf_interpret, but optionally starting from, and saving, interpreter state
+ *
+ * @param  start  state to start from, or NULL to start from an empty tape
+ * @param  end    location to store state after the BF program finishes, or NULL.
+ *                Only written if interpretation succeeds. If the BF program moved
+ *                the data pointer past BF_STATE_TAPE_SIZE, the state can't be
+ *                stored, and BF_ERR_INVALID is returned.
+ *
+ * @see bf_interpret for the other parameters, and return value
+ */
+int bf_interpret_ex(char *prog, const char *input, size_t input_len, char *output, size_t max_output,
+                    int max_instructions, const bf_state_t *start, bf_state_t *end);
+
+/**
+ * Compile a BF program to a list of instructions, merging each run of identical
+ * '+', '-', '<' or '>' characters into a single instruction and resolving the
+ * destinations of all loops ahead of time, so the BF program can be run many times
+ * (e.g. once for each test case) without parsing it again each time.
+ *
+ * @param  prog      BF string to compile
+ * @param  code      location to store instructions
+ * @param  max_code  max. number of instructions that can be stored in 'code'. The
+ *                   number of instructions is never more than the length of 'prog'.
+ * @return number of instructions, or BF_ERR_INVALID if the brackets in the BF
+ *         program are not balanced, nested too deep, or if 'code' is too small.
+ *         Such BF programs can still be run with bf_interpret.
+ */
+int bf_compile(const char *prog, bf_insn_t *code, size_t max_code);
+
+/**
+ * Same as bf_interpret_ex, but runs a BF program compiled by bf_compile. Gives
+ * the same results as running the BF program that it was compiled from with
+ * bf_interpret_ex.
+ *
+ * @param  code      instructions returned by bf_compile
+ * @param  code_len  number of instructions returned by bf_compile
+ *
+ * @see bf_interpret_ex for the other parameters, and return value
+ */
+int bf_execute_ex(const bf_insn_t *code, int code_len, const char *input, size_t input_len,
+                  char *output, size_t max_output, int max_instructions, const bf_state_t *start,
+                  bf_state_t *end);
+
+/**
+ * Record, for each output character printed by bf_interpret, bf_interpret_ex or
+ * bf_execute_ex, the index of the '.' symbol in the BF program that printed it
+ *
+ * @param  trace  location to store indices, with room for as many indices as the
+ *                'max_output' passed to every call, or NULL to stop recording
+ */
+void bf_trace_output(int *trace);
+
+/**
+ * Get the number of instructions executed by the last call to bf_interpret,
+ * bf_interpret_ex or bf_execute_ex.
+ * A run of identical '+', '-', '<' or '>' characters counts as one instruction.
+ *
+ * @return number of instructions executed
+ */
+int bf_last_instruction_count(void);
+
+/**
+ * Get the number of input characters read by the last call to bf_interpret,
+ * bf_interpret_ex or bf_execute_ex.
+ *
+ * @return number of input characters read
+ */
+int bf_last_input_count(void);
+
+/**
+ * Build a BF program that prints a string of characters, using a single tape
+ * cell, by adding or subtracting the difference between each character and the
+ * previous one (whichever is shorter) before printing it. The cell is only
+ * decremented when it doesn't have to wrap around zero.
+ *
+ * @param  text      characters to print
+ * @param  text_len  number of characters to print
+ * @param  program   location to store the null-terminated BF program
+ * @param  max_len   max. length of the BF program, not including the null terminator
+ * @return length of the BF program, or -1 if it would be longer than max_len
+ */
+int bf_print_program(const char *text, size_t text_len, char *program, size_t max_len);
+
 /**
  * Generate a string of randomly-selected BF symbols
  *
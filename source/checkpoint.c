@@ -0,0 +1,334 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "common.h"
+#include "checkpoint.h"
+
+#if WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif /* WINDOWS */
+
+
+#define TMP_SUFFIX ".tmp"
+
+
+static char *_path = NULL;
+static char *_tmp_path = NULL;
+
+// Snapshot buffer owned by the writer thread while _busy is set
+static uint8_t *_snapshot = NULL;
+static checkpoint_header_t _snapshot_header;
+static size_t _max_size = 0u;
+
+static bool _running = false;
+static bool _busy = false;
+static bool _quit = false;
+
+#if WINDOWS
+static HANDLE _thread;
+static CRITICAL_SECTION _lock;
+static CONDITION_VARIABLE _cond;
+
+#define LOCK()        EnterCriticalSection(&_lock)
+#define UNLOCK()      LeaveCriticalSection(&_lock)
+#define WAIT()        SleepConditionVariableCS(&_cond, &_lock, INFINITE)
+#define WAKE()        WakeAllConditionVariable(&_cond)
+#else
+static pthread_t _thread;
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _cond = PTHREAD_COND_INITIALIZER;
+
+#define LOCK()        pthread_mutex_lock(&_lock)
+#define UNLOCK()      pthread_mutex_unlock(&_lock)
+#define WAIT()        pthread_cond_wait(&_cond, &_lock)
+#define WAKE()        pthread_cond_broadcast(&_cond)
+#endif /* WINDOWS */
+
+
+// Write a checkpoint file to a temporary path, and then move it into place, so
+// that an interrupted write never leaves behind a truncated checkpoint
+static int _write_file(const checkpoint_header_t *header, const void *data)
+{
+    static const uint8_t zeros[CHECKPOINT_DATA_OFFSET] = {0};
+
+    FILE *fp = fopen(_tmp_path, "wb");
+    if (NULL == fp)
+    {
+        bfi_log("Failed to open %s for writing", _tmp_path);
+        return -1;
+    }
+
+    int ret = 0;
+
+    if ((1u != fwrite(header, sizeof(checkpoint_header_t), 1u, fp)) ||
+        (1u != fwrite(zeros, header->data_offset - sizeof(checkpoint_header_t), 1u, fp)) ||
+        (1u != fwrite(data, header->data_size, 1u, fp)))
+    {
+        bfi_log("Failed to write checkpoint to %s", _tmp_path);
+        ret = -1;
+    }
+
+    if (0 != fclose(fp))
+    {
+        ret = -1;
+    }
+
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+#if WINDOWS
+    if (!MoveFileEx(_tmp_path, _path, MOVEFILE_REPLACE_EXISTING))
+#else
+    if (0 != rename(_tmp_path, _path))
+#endif /* WINDOWS */
+    {
+        bfi_log("Failed to move %s to %s", _tmp_path, _path);
+        return -1;
+    }
+
+    return 0;
+}
+
+#if WINDOWS
+static DWORD WINAPI _writer_thread(LPVOID arg)
+#else
+static void *_writer_thread(void *arg)
+#endif /* WINDOWS */
+{
+    (void) arg;
+
+    LOCK();
+
+    while (!_quit)
+    {
+        if (!_busy)
+        {
+            WAIT();
+            continue;
+        }
+
+        // Snapshot buffer is not touched by the main thread while _busy is set
+        UNLOCK();
+        (void) _write_file(&_snapshot_header, _snapshot);
+        LOCK();
+
+        _busy = false;
+        WAKE();
+    }
+
+    UNLOCK();
+
+#if WINDOWS
+    return 0;
+#else
+    return NULL;
+#endif /* WINDOWS */
+}
+
+// Block until the writer thread is not busy. Must be called with the lock held.
+static void _wait_idle(void)
+{
+    while (_busy)
+    {
+        WAIT();
+    }
+}
+
+/**
+ * @see checkpoint.h
+ */
+int checkpoint_writer_start(const char *path, size_t max_size)
+{
+    size_t pathlen = strlen(path);
+
+    _path = malloc(pathlen + 1u);
+    _tmp_path = malloc(pathlen + sizeof(TMP_SUFFIX));
+    _snapshot = malloc(max_size);
+
+    if ((NULL == _path) || (NULL == _tmp_path) || (NULL == _snapshot))
+    {
+        bfi_log("Failed to allocate memory for checkpoint writer");
+        checkpoint_writer_stop();
+        return -1;
+    }
+
+    memcpy(_path, path, pathlen + 1u);
+    memcpy(_tmp_path, path, pathlen);
+    memcpy(_tmp_path + pathlen, TMP_SUFFIX, sizeof(TMP_SUFFIX));
+
+    _max_size = max_size;
+    _busy = false;
+    _quit = false;
+
+#if WINDOWS
+    InitializeCriticalSection(&_lock);
+    InitializeConditionVariable(&_cond);
+
+    _thread = CreateThread(NULL, 0, _writer_thread, NULL, 0, NULL);
+    if (NULL == _thread)
+#else
+    if (0 != pthread_create(&_thread, NULL, _writer_thread, NULL))
+#endif /* WINDOWS */
+    {
+        bfi_log("Failed to start checkpoint writer thread");
+        checkpoint_writer_stop();
+        return -1;
+    }
+
+    _running = true;
+    return 0;
+}
+
+/**
+ * @see checkpoint.h
+ */
+int checkpoint_write_async(const checkpoint_header_t *header, const void *data)
+{
+    if (!_running || (header->data_size > _max_size))
+    {
+        return -1;
+    }
+
+    LOCK();
+
+    if (_busy)
+    {
+        UNLOCK();
+        return 1;
+    }
+
+    memcpy(&_snapshot_header, header, sizeof(checkpoint_header_t));
+    memcpy(_snapshot, data, header->data_size);
+    _busy = true;
+    WAKE();
+
+    UNLOCK();
+    return 0;
+}
+
+/**
+ * @see checkpoint.h
+ */
+int checkpoint_write_sync(const checkpoint_header_t *header, const void *data)
+{
+    if (!_running)
+    {
+        return -1;
+    }
+
+    LOCK();
+    _wait_idle();
+    UNLOCK();
+
+    return _write_file(header, data);
+}
+
+/**
+ * @see checkpoint.h
+ */
+void checkpoint_writer_stop(void)
+{
+    if (_running)
+    {
+        LOCK();
+        _wait_idle();
+        _quit = true;
+        WAKE();
+        UNLOCK();
+
+#if WINDOWS
+        WaitForSingleObject(_thread, INFINITE);
+        CloseHandle(_thread);
+        DeleteCriticalSection(&_lock);
+#else
+        pthread_join(_thread, NULL);
+#endif /* WINDOWS */
+
+        _running = false;
+    }
+
+    free(_path);
+    free(_tmp_path);
+    free(_snapshot);
+
+    _path = NULL;
+    _tmp_path = NULL;
+    _snapshot = NULL;
+}
+
+/**
+ * @see checkpoint.h
+ */
+int checkpoint_read_header(const char *path, checkpoint_header_t *header)
+{
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp)
+    {
+        bfi_log("Failed to open %s for reading", path);
+        return -1;
+    }
+
+    size_t nread = fread(header, sizeof(checkpoint_header_t), 1u, fp);
+    fclose(fp);
+
+    if (1u != nread)
+    {
+        bfi_log("Failed to read checkpoint header from %s", path);
+        return -1;
+    }
+
+    if ((0 != memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic))) ||
+        (CHECKPOINT_VERSION != header->version))
+    {
+        bfi_log("%s is not a valid checkpoint file", path);
+        return -1;
+    }
+
+    if (header->data_offset < sizeof(checkpoint_header_t))
+    {
+        bfi_log("%s is corrupt", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @see checkpoint.h
+ */
+int checkpoint_read_data(const char *path, const checkpoint_header_t *header, void *data)
+{
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp)
+    {
+        bfi_log("Failed to open %s for reading", path);
+        return -1;
+    }
+
+    int ret = 0;
+
+    if ((0 != fseek(fp, (long) header->data_offset, SEEK_SET)) ||
+        (1u != fread(data, header->data_size, 1u, fp)))
+    {
+        bfi_log("Failed to read checkpoint data from %s", path);
+        ret = -1;
+    }
+
+    fclose(fp);
+    return ret;
+}
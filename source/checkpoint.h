@@ -0,0 +1,153 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define CHECKPOINT_MAGIC    "BFICKPT"
+#define CHECKPOINT_VERSION  (4u)
+
+// Offset of the population data in a checkpoint file. Keeps the population
+// page-aligned, so the file can be memory-mapped and used directly.
+#define CHECKPOINT_DATA_OFFSET (4096u)
+
+// Max. number of mutation operators whose statistics can be stored in a checkpoint
+#define CHECKPOINT_MAX_MUTATIONS (16u)
+
+
+/**
+ * Header at the start of a checkpoint file. All fields have fixed sizes, and
+ * are ordered such that the compiler inserts no padding.
+ */
+typedef struct
+{
+    // Must be CHECKPOINT_MAGIC, including the null terminator
+    char magic[8];
+
+    // Must be CHECKPOINT_VERSION
+    uint32_t version;
+
+    // Offset of population data from the start of the file
+    uint32_t data_offset;
+
+    // Size in bytes of the population data (both population buffers + best item)
+    uint64_t data_size;
+
+    // Size in bytes of a single BF program in the population
+    uint64_t prog_size_bytes;
+
+    // Fingerprint of the test cases that the population was scored against
+    uint64_t testcase_fingerprint;
+
+    // Random number generator state
+    uint64_t rng_state;
+    uint64_t rng_inc;
+
+    // Evolution config (only the fields that affect the population layout + scoring)
+    uint64_t max_program_size;
+    float elitism;
+    float crossover;
+    float mutation;
+    uint32_t population_size;
+    int32_t num_optimization_gens;
+    uint32_t always_penalize_length;
+
+    // Evolution state
+    uint32_t active_pop_index;
+    uint32_t generation;
+    uint32_t optimizing;
+    uint32_t optgen_count;
+
+    // Configured rates, before any changes made by adaptive rates
+    float initial_elitism;
+    float initial_crossover;
+    float initial_mutation;
+
+    // Generation at which the fittest BF program last improved, for stagnation detection
+    uint32_t last_improved_gen;
+
+    // Population size that stagnation restarts can grow the population up to
+    uint32_t max_population_size;
+
+    // Decayed mutation operator statistics, for adaptive mutation
+    float mutation_trials[CHECKPOINT_MAX_MUTATIONS];
+    float mutation_successes[CHECKPOINT_MAX_MUTATIONS];
+
+    // Unused, keeps the header size a multiple of 8 bytes
+    uint32_t reserved;
+} checkpoint_header_t;
+
+
+/**
+ * Start the background checkpoint writer
+ *
+ * @param path       path of checkpoint file to write
+ * @param max_size   maximum size in bytes of population data that will be written
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int checkpoint_writer_start(const char *path, size_t max_size);
+
+/**
+ * Copy a snapshot of the evolution state, and hand it to the background writer.
+ * If the writer is still busy with the previous snapshot, nothing is copied and
+ * the snapshot is skipped, so that evolution never waits on disk I/O.
+ *
+ * @param header  pointer to checkpoint header
+ * @param data    pointer to population data
+ *
+ * @return 0 if snapshot was handed to the writer, 1 if the writer was busy and
+ *         the snapshot was skipped, or -1 if the writer is not running or the
+ *         population data is bigger than the max_size passed to
+ *         checkpoint_writer_start
+ */
+int checkpoint_write_async(const checkpoint_header_t *header, const void *data);
+
+/**
+ * Wait for any pending background write to finish, and then write a snapshot
+ * of the evolution state synchronously.
+ *
+ * @param header  pointer to checkpoint header
+ * @param data    pointer to population data
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int checkpoint_write_sync(const checkpoint_header_t *header, const void *data);
+
+/**
+ * Wait for any pending background write to finish, and stop the writer
+ */
+void checkpoint_writer_stop(void);
+
+/**
+ * Read the header from a checkpoint file, and validate it
+ *
+ * @param path    path of checkpoint file to read
+ * @param header  location to store checkpoint header
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int checkpoint_read_header(const char *path, checkpoint_header_t *header);
+
+/**
+ * Read the population data from a checkpoint file
+ *
+ * @param path    path of checkpoint file to read
+ * @param header  pointer to checkpoint header previously read from the same file
+ * @param data    location to store population data (must be at least
+ *                header->data_size bytes)
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int checkpoint_read_data(const char *path, const checkpoint_header_t *header, void *data);
+
+#endif // CHECKPOINT_H
@@ -20,6 +20,10 @@
 #include <windows.h>
 #else
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <time.h>
 #endif /* WINDOWS */
 
@@ -45,6 +49,40 @@ uint32_t pcg32_rand(void)
     return pcg32_random_r(&_pcg_rng);
 }
 
+/**
+ * @see common.h
+ */
+void pcg32_get_state(uint64_t *state, uint64_t *inc)
+{
+    *state = _pcg_rng.state;
+    *inc = _pcg_rng.inc;
+}
+
+/**
+ * @see common.h
+ */
+void pcg32_set_state(uint64_t state, uint64_t inc)
+{
+    _pcg_rng.state = state;
+    _pcg_rng.inc = inc;
+}
+
+/**
+ * @see common.h
+ */
+uint64_t hash_bytes(const void *data, size_t size, uint64_t hash)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+
+    for (size_t i = 0u; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
 /**
  * @see common.h
  */
@@ -205,6 +243,106 @@ uint64_t ms_since_epoch(void)
     return ret;
 }
 
+/**
+ * @see common.h
+ */
+uint64_t monotonic_ns(void)
+{
+#if WINDOWS
+    LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    uint64_t secs = count.QuadPart / freq.QuadPart;
+    uint64_t rem = count.QuadPart % freq.QuadPart;
+    uint64_t ret = (secs * 1000000000ULL) + ((rem * 1000000000ULL) / freq.QuadPart);
+
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ret = ((uint64_t) ts.tv_sec) * 1000000000ULL;
+    ret += (uint64_t) ts.tv_nsec;
+#endif
+
+    return ret;
+}
+
+/**
+ * @see common.h
+ */
+const void *map_file(const char *path, size_t *size)
+{
+    void *data = NULL;
+
+#if WINDOWS
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == file)
+    {
+        return NULL;
+    }
+
+    LARGE_INTEGER filesize;
+    if (GetFileSizeEx(file, &filesize) && (0 < filesize.QuadPart))
+    {
+        HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (NULL != mapping)
+        {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            *size = (size_t) filesize.QuadPart;
+
+            // View keeps the mapping alive
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    if (0 > fd)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if ((0 == fstat(fd, &st)) && (0 < st.st_size))
+    {
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED == data)
+        {
+            data = NULL;
+        }
+
+        *size = (size_t) st.st_size;
+    }
+
+    // Mapping stays valid after the file is closed
+    close(fd);
+#endif /* WINDOWS */
+
+    return data;
+}
+
+/**
+ * @see common.h
+ */
+void unmap_file(const void *data, size_t size)
+{
+    if (NULL == data)
+    {
+        return;
+    }
+
+#if WINDOWS
+    (void) size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void *) data, size);
+#endif /* WINDOWS */
+}
+
 /**
  * @see common.h
  */
@@ -10,6 +10,7 @@
 #define COMMON_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 
 #if defined __linux__
@@ -23,11 +24,45 @@
 #define MIN_VAL(x, y) (((x) < (y)) ? (x) : (y))
 #define MAX_VAL(x, y) (((x) > (y)) ? (x) : (y))
 
+// Round x up to a multiple of a
+#define ALIGN_UP(x, a) ((((x) + (a) - 1u) / (a)) * (a))
+
 
 void pcg32_seed(unsigned int seedval);
 
 uint32_t pcg32_rand(void);
 
+/**
+ * Read the complete internal state of the random number generator, e.g. for
+ * saving a checkpoint
+ *
+ * @param   state  location to store the generator state
+ * @param   inc    location to store the generator stream increment
+ */
+void pcg32_get_state(uint64_t *state, uint64_t *inc);
+
+/**
+ * Restore the complete internal state of the random number generator, as
+ * previously read by pcg32_get_state
+ *
+ * @param   state  generator state
+ * @param   inc    generator stream increment
+ */
+void pcg32_set_state(uint64_t state, uint64_t inc);
+
+/**
+ * Compute a 64-bit FNV-1a hash of a block of memory
+ *
+ * @param   data  pointer to data to hash
+ * @param   size  number of bytes to hash
+ * @param   hash  initial hash value, pass HASH_INIT to start a new hash, or
+ *                the result of a previous call to continue hashing
+ * @return  updated hash value
+ */
+uint64_t hash_bytes(const void *data, size_t size, uint64_t hash);
+
+#define HASH_INIT (0xcbf29ce484222325ULL)
+
 /**
  * Get  random number in specific range
  *
@@ -79,6 +114,31 @@ void hrcount (uint64_t size, char *buf, unsigned int bufsize);
  */
 uint64_t ms_since_epoch(void);
 
+/**
+ * Gets the number of nanoseconds elapsed on a monotonic clock, for measuring
+ * short intervals. The starting point is arbitrary.
+ */
+uint64_t monotonic_ns(void);
+
+/**
+ * Map the contents of a file into memory, read-only
+ *
+ * @param path   path of file to map
+ * @param size   location to store the size of the file in bytes
+ *
+ * @return pointer to file contents, or NULL if the file does not exist, is empty,
+ *         or could not be mapped
+ */
+const void *map_file(const char *path, size_t *size);
+
+/**
+ * Unmap a file previously mapped by map_file
+ *
+ * @param data   pointer returned by map_file (may be NULL)
+ * @param size   size of the file in bytes, as written by map_file
+ */
+void unmap_file(const void *data, size_t size);
+
 /**
  * Logs a formatted string
  *
@@ -0,0 +1,182 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bf_utils.h"
+#include "common.h"
+#include "divide.h"
+
+
+/* Returns true if a BF program prints 'expected' when started from 'start', and
+ * stores the interpreter state it leaves behind in 'end' (if not NULL). 'buf'
+ * must have room for expected_size + 1 characters. */
+static bool _check_program(char *program, const char *expected, size_t expected_size,
+                           const bf_state_t *start, bf_state_t *end, char *buf)
+{
+    int len = bf_interpret_ex(program, NULL, 0u, buf, expected_size, MAX_INSTRUCTIONS_EXEC,
+                              start, end);
+
+    return (((int) expected_size) == len) && (0 == memcmp(buf, expected, expected_size));
+}
+
+/**
+ * @see divide.h
+ */
+int divide_and_conquer(evolution_testcase_t *testcase, size_t segment_size,
+                       evolution_config_t *config, evolution_output_t *output)
+{
+    if ((NULL == testcase) || (NULL == config) || (NULL == output) ||
+        (0u != testcase->input_size) || (0u == segment_size))
+    {
+        return -1;
+    }
+
+    size_t num_segments = (testcase->output_size + segment_size - 1u) / segment_size;
+    size_t segment_max_len = config->max_program_size / MAX_VAL(num_segments, 1u);
+
+    if (2u > segment_max_len)
+    {
+        bfi_log("Max. BF program size is too small for %zu segments", num_segments);
+        return -1;
+    }
+
+    evolution_output_t *segment_output = malloc(sizeof(evolution_output_t) + segment_max_len + 1u);
+    char *program = malloc(config->max_program_size + 1u);
+    char *buf = malloc(testcase->output_size + 1u);
+
+    if ((NULL == segment_output) || (NULL == program) || (NULL == buf))
+    {
+        bfi_log("Failed to allocate memory");
+        free(segment_output);
+        free(program);
+        free(buf);
+        return -1;
+    }
+
+    uint64_t start_ms = ms_since_epoch();
+    uint64_t num_bf_programs = 0u;
+    uint32_t num_generations = 0u;
+    size_t program_len = 0u;
+    bool solved = true;
+    int ret = 0;
+
+    bf_state_t state;
+    bf_state_t end_state;
+    evolution_testcase_t segment;
+
+    memset(&state, 0, sizeof(state));
+    segment.input = NULL;
+    segment.input_size = 0u;
+    program[0] = 0;
+
+    for (size_t i = 0u; i < num_segments; i++)
+    {
+        size_t offset = i * segment_size;
+
+        segment.output = testcase->output + offset;
+        segment.output_size = MIN_VAL(segment_size, testcase->output_size - offset);
+
+        evolution_config_t segment_config = *config;
+        segment_config.max_program_size = segment_max_len;
+        segment_config.start_state = &state;
+        segment_config.seed_programs = NULL;
+        segment_config.num_seed_programs = 0u;
+        segment_config.baseline_program = NULL;
+
+        if (!config->quiet)
+        {
+            bfi_log("segment %zu of %zu: \"%.*s\"", i + 1u, num_segments,
+                    (int) segment.output_size, segment.output);
+            fflush(stdout);
+        }
+
+        if (evolve_bf_program(&segment, 1u, &segment_config, segment_output) < 0)
+        {
+            ret = -1;
+            break;
+        }
+
+        num_bf_programs += segment_output->num_bf_programs;
+        num_generations += segment_output->num_generations;
+
+        size_t len = strlen(segment_output->bf_program);
+        memcpy(program + program_len, segment_output->bf_program, len + 1u);
+        program_len += len;
+
+        // Evolution may have been stopped before the segment was solved (Ctrl-C)
+        if (!_check_program(segment_output->bf_program, segment.output, segment.output_size,
+                            &state, &end_state, buf))
+        {
+            bfi_log("segment %zu of %zu not solved, stopping", i + 1u, num_segments);
+            solved = false;
+            break;
+        }
+
+        memcpy(&state, &end_state, sizeof(state));
+    }
+
+    free(segment_output);
+
+    if (0 != ret)
+    {
+        free(program);
+        free(buf);
+        return ret;
+    }
+
+    uint64_t solved_ms = ms_since_epoch() - start_ms;
+
+    output->first_solution_ms = (solved) ? solved_ms : EVOLUTION_NO_TIME;
+    output->final_program_ms = solved_ms;
+
+    /* Joined-up BF program can only be evolved further if it passes within the
+     * instruction limit used during evolution */
+    if (solved && (0 != config->num_optimization_gens) &&
+        _check_program(program, testcase->output, testcase->output_size, NULL, NULL, buf))
+    {
+        evolution_config_t polish_config = *config;
+        const char *seed = program;
+
+        polish_config.seed_programs = &seed;
+        polish_config.num_seed_programs = 1u;
+        polish_config.start_state = NULL;
+
+        if (!config->quiet)
+        {
+            bfi_log("all segments solved, optimizing joined program for length");
+            fflush(stdout);
+        }
+
+        ret = evolve_bf_program(testcase, 1u, &polish_config, output);
+        if (0 == ret)
+        {
+            // Joined-up BF program is final if it was never improved on
+            output->final_program_ms = (EVOLUTION_NO_TIME == output->final_program_ms) ?
+                                       solved_ms : (output->final_program_ms + solved_ms);
+            output->first_solution_ms = solved_ms;
+        }
+    }
+    else
+    {
+        memcpy(output->bf_program, program, program_len + 1u);
+        output->num_bf_programs = 0u;
+        output->num_generations = 0u;
+    }
+
+    output->num_bf_programs += num_bf_programs;
+    output->num_generations += num_generations;
+
+    free(program);
+    free(buf);
+    return ret;
+}
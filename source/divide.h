@@ -0,0 +1,37 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#ifndef DIVIDE_H
+#define DIVIDE_H
+
+#include <stddef.h>
+
+#include "evolution.h"
+
+
+/**
+ * Evolve a BF program that prints the expected output of a test case with no
+ * input, by splitting the expected output into segments. A BF program is evolved
+ * for each segment in turn, starting from the interpreter state left behind by
+ * the BF program for the previous segment. The BF programs for all segments are
+ * then joined together, and evolved further to shorten them. All output is
+ * provided via stdout.
+ *
+ * @param testcase      Pointer to test case with no input
+ * @param segment_size  Max. number of expected output characters in each segment
+ * @param config        Pointer to configuration options, used for every segment.
+ *                      max_program_size is shared between all segments.
+ * @param output        Pointer to location to store evolution result. Must have
+ *                      room for a BF program of config->max_program_size characters.
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int divide_and_conquer(evolution_testcase_t *testcase, size_t segment_size,
+                       evolution_config_t *config, evolution_output_t *output);
+
+#endif // DIVIDE_H
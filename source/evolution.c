@@ -11,10 +11,13 @@
 #include <stdint.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
 
 #include "bf_utils.h"
+#include "checkpoint.h"
 #include "common.h"
 #include "evolution.h"
+#include "fitness.h"
 
 #if WINDOWS
 #include <windows.h>
@@ -28,14 +31,49 @@
 // Number of items involved in a tournament
 #define TOURNAMENT_SIZE  (12)
 
-// If a BF program executes more than this many instructions, it will be considered timed out
-#define MAX_INSTRUCTIONS_EXEC (10000)
+// Per-generation decay factor for test case failure statistics, for ordered test cases
+#define TESTCASE_STATS_DECAY (0.9f)
+
+// If a BF program prints this many characters more than the expected output, it will be considered timed out
+#define MAX_EXTRA_OUTPUT (128u)
+
+// Size of a single BF program in the population, not including per-test-case errors
+#define BF_PROG_TEXT_BYTES (sizeof(bf_program_t) + config->max_program_size + 1u)
 
 // Size of a single BF program in the population
-#define BF_PROG_SIZE_BYTES (sizeof(bf_program_t) + config->max_program_size + 1u)
+#define BF_PROG_SIZE_BYTES (BF_PROG_TEXT_BYTES + _errors_size)
+
+// Get a pointer to the per-test-case errors of a BF program (lexicase selection only)
+#define BF_PROG_ERRORS(prog) ((uint32_t *) (((uint8_t *) (prog)) + _errors_offset))
+
 
 #define BF_MIN_PROG_SIZE (2)
 
+// Max. number of symbols added to/removed from a run by a single run-length mutation
+#define RUN_MAX_DELTA (4u)
+
+// Max. number of symbols in a new run added by a run-length mutation
+#define RUN_MAX_NEW_COUNT (8u)
+
+// Max. number of new runs added by a single run-length mutation
+#define RUN_MAX_NEW_RUNS (8u)
+
+// Number of characters up to the blamed '.', within which output credit assignment places mutations
+#define CREDIT_WINDOW (16u)
+
+// bf_program_t blame value for BF programs with no blamed '.'
+#define BLAME_NONE (UINT32_MAX)
+
+/* Number of generations between attempts to lock a longer prefix. A prefix is
+ * only locked if the fittest BF program had it at the previous attempt, too. */
+#define LOCK_INTERVAL (25u)
+
+// Number of scratch BF programs for holding the unlocked parts of BF programs
+#define NUM_LOCK_PARTS (4u)
+
+// Max. number of mutations applied to a duplicate BF program to make it unique
+#define DEDUP_MAX_MUTATIONS (4u)
+
 // Convert a population index to a pointer to the corresponding BF program
 #define BF_PROG_INDEX(i) ((bf_program_t *) (((uint8_t *) _population) + (BF_PROG_SIZE_BYTES * (i))))
 
@@ -47,6 +85,54 @@
 
 #define MINVAL(x, y) (((x) < (y)) ? x : y)
 
+// Per-generation decay factor for mutation operator success statistics, so
+// adaptive mutation selection tracks the current stage of evolution
+#define MUTATION_STATS_DECAY (0.9f)
+
+// Softmax temperature for adaptive mutation selection, relative to the mean
+// success rate. Lower values favour the most successful operators more strongly.
+#define MUTATION_TEMPERATURE (0.5f)
+
+// Share of mutations for which the operator is always picked uniformly, so that
+// operators with a low success rate are still tried occasionally
+#define MUTATION_EXPLORE (0.2f)
+
+// Share of new BF programs that must be fitter than their parents for adaptive
+// rates to move towards exploitation rather than exploration
+#define ADAPT_TARGET_IMPROVEMENT (0.05f)
+
+// Share of distinct fitness values among elite items, below which adaptive rates
+// consider diversity to have collapsed
+#define ADAPT_MIN_DIVERSITY (0.1f)
+
+// Multiplicative step size for adaptive rates, per generation
+#define ADAPT_STEP (1.05f)
+
+// Number of mutations applied to each BF program by STAGNATION_HYPERMUTATE
+#define HYPERMUTATION_COUNT (8u)
+
+// Share of elite items with the same fitness as the fittest item, at or above which
+// the population is considered to have converged, for stagnation detection
+#define STAGNATION_CONVERGED_SHARE (0.2f)
+
+// Maximum number of mutations applied to each copy of a seed program in the
+// initial population
+#define SEED_MAX_MUTATIONS (4u)
+
+// Share of the population replaced with random BF programs by STAGNATION_RESEED
+#define RESEED_SHARE (0.5f)
+
+// Share of the population kept by STAGNATION_RESTART
+#define RESTART_KEEP_SHARE (0.02f)
+
+// Population size is doubled by each STAGNATION_RESTART, up to this many times
+// the configured population size
+#define RESTART_MAX_GROWTH (16u)
+
+// Bounds for adaptive rates
+#define ADAPT_MIN_RATE (0.1f)
+#define ADAPT_MAX_ELITISM (0.9f)
+
 
 /**
  * Holds the text for a single BF program, + a fitness score (lower is better)
@@ -54,6 +140,15 @@
 typedef struct
 {
     uint32_t fitness;
+
+    /* Index of the '.' that printed the first wrong output character (or of the
+     * character after the last '.', if the output was too short), or BLAME_NONE.
+     * Only set with output credit assignment. */
+    uint32_t blame;
+
+    // True if fitness was estimated from a subset of test cases
+    bool sampled;
+
     size_t program_len;
     char text[];
 } bf_program_t;
@@ -89,6 +184,27 @@ typedef enum {
     NUM_MUTATIONS
 } mutation_e;
 
+/**
+ * Interpreter state left behind by the locked prefix on a single test case, and
+ * how much of the test case the locked prefix used up
+ */
+typedef struct
+{
+    bf_state_t state;
+    size_t input_offset;
+    size_t output_offset;
+    int instructions;
+} bf_lock_t;
+
+/**
+ * A single gene of the run-length genome; a run of identical BF symbols
+ */
+typedef struct
+{
+    char op;
+    uint32_t count;
+} bf_run_t;
+
 
 static volatile bool _stopped = false;
 static uint32_t _elite_border = 0u;
@@ -96,12 +212,115 @@ static uint32_t _active_pop_index = 0u;
 static uint32_t _generation = 0u;
 
 static evolution_testcase_t *_testcases = NULL;
+static char *_output = NULL;
+static size_t _scratch_size = 0u;
+static size_t _fitness_buffer_size = 0u;
+static size_t _max_output_size = 0u;
+static bf_insn_t *_code = NULL;
+static size_t _max_code = 0u;
+static size_t _max_trace = 0u;
+static bf_run_t *_runs = NULL;
+static int *_trace = NULL;
+static const bf_state_t *_start_state = NULL;
 static unsigned int _num_testcases = 0u;
 static bf_program_t *_population = NULL;
 static bf_program_t *_best_item;
 
 static bool _penalize_length = false;
 
+// Counters for telemetry, reset each time a telemetry record is written
+static uint64_t _num_assessed = 0u;
+static uint64_t _num_invalid = 0u;
+static uint64_t _num_timeouts = 0u;
+static uint64_t _num_dedup_checked = 0u;
+static uint64_t _num_duplicates = 0u;
+
+// Same as _num_dedup_checked and _num_duplicates, but never reset
+static uint64_t _total_dedup_checked = 0u;
+static uint64_t _total_duplicates = 0u;
+
+// Fingerprints of the BF programs in the next population, for deduplication. 0
+// marks an empty slot.
+static uint64_t *_fingerprints = NULL;
+static size_t _fingerprints_size = 0u;
+
+static FILE *_telemetry_fp = NULL;
+
+/* Number of characters locked at the start of every BF program (0 if no prefix
+ * is locked), and the state left behind by the locked prefix on each test case */
+static size_t _locked_len = 0u;
+static bf_lock_t *_locks = NULL;
+
+/* Prefix locking workspace; candidate prefix lengths, locked prefix text, text of
+ * the prefix found at the previous attempt, text of a candidate prefix, and BF
+ * programs holding the unlocked parts of BF programs */
+static uint32_t *_lock_cuts = NULL;
+static char *_lock_prefix = NULL;
+static char *_lock_candidate = NULL;
+static size_t _lock_candidate_len = 0u;
+static char *_lock_text = NULL;
+static bf_program_t *_lock_parts[NUM_LOCK_PARTS];
+
+// Total number of BF programs created & executed
+static uint64_t _num_bf_programs = 0u;
+
+// Decayed number of times each mutation operator was applied + assessed, and how
+// many of those times it produced a BF program fitter than its parent
+static float _mutation_trials[NUM_MUTATIONS];
+static float _mutation_successes[NUM_MUTATIONS];
+
+// Cumulative selection probability of each mutation operator, for adaptive mutation
+static float _mutation_cdf[NUM_MUTATIONS];
+
+_Static_assert(NUM_MUTATIONS <= CHECKPOINT_MAX_MUTATIONS, "Mutation statistics don't fit in checkpoints");
+
+// Configured rates, restored at the start of the optimization stage if adapting rates
+static float _initial_elitism = 0.0f;
+static float _initial_crossover = 0.0f;
+static float _initial_mutation = 0.0f;
+
+// Generation at which the fittest BF program last improved, for stagnation detection
+static uint32_t _last_improved_gen = 0u;
+
+// Population size that STAGNATION_RESTART can grow the population up to
+static uint32_t _max_population_size = 0u;
+
+// Number of new BF programs assessed in the current generation, and how many of
+// those were fitter than their parents
+static uint32_t _children_assessed = 0u;
+static uint32_t _children_improved = 0u;
+
+/* Decayed number of times each test case was run, and how many of those times
+ * it failed, plus the order to run test cases in. Only used for ordered test cases. */
+static float *_testcase_runs = NULL;
+static float *_testcase_fails = NULL;
+static unsigned int *_testcase_order = NULL;
+
+// BF programs whose fitness exceeds this value part way through assessment can no
+// longer make it into the elite, and are not assessed any further
+static uint32_t _abort_fitness = UINT32_MAX;
+
+/* Test cases that new BF programs are assessed on in the current generation, for
+ * test case subsampling. The first _subset_size items are the current subset, and
+ * the rest are all the other test cases. */
+static unsigned int *_subset = NULL;
+static unsigned int _subset_size = 0u;
+
+// Offset of per-test-case errors from the start of a BF program, and number of
+// bytes they add to each BF program. Both are 0 unless using lexicase selection.
+static size_t _errors_offset = 0u;
+static size_t _errors_size = 0u;
+
+/* Lexicase selection workspace; errors of the active population, stored by test
+ * case (all errors for test case 0 first), followed by candidate indices, test
+ * case order, and epsilon-lexicase tolerance per test case */
+static uint32_t *_lexicase_buf = NULL;
+static uint32_t _lexicase_capacity = 0u;
+static uint32_t *_lexicase_errors = NULL;
+static uint32_t *_lexicase_pool = NULL;
+static uint32_t *_lexicase_cases = NULL;
+static uint32_t *_lexicase_epsilon = NULL;
+
 
 #if WINDOWS
 BOOL WINAPI win_sighandler(DWORD type)
@@ -138,68 +357,429 @@ static int _cmporgs(const void *a, const void *b)
     return 0;
 }
 
+// Compute a fingerprint of all test cases, so a checkpoint can't be resumed
+// against test cases that it was not scored with
+static uint64_t _testcase_fingerprint(void)
+{
+    uint64_t hash = HASH_INIT;
+
+    for (unsigned int i = 0u; i < _num_testcases; i++)
+    {
+        uint64_t sizes[2] = {_testcases[i].input_size, _testcases[i].output_size};
+        hash = hash_bytes(sizes, sizeof(sizes), hash);
+        hash = hash_bytes(_testcases[i].input, _testcases[i].input_size, hash);
+        hash = hash_bytes(_testcases[i].output, _testcases[i].output_size, hash);
+    }
+
+    return hash;
+}
+
+// Write a checkpoint of the complete evolution state
+static int _checkpoint(evolution_config_t *config, size_t data_size, bool optimizing,
+                       unsigned int optgen_count, bool sync)
+{
+    checkpoint_header_t header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.data_offset = CHECKPOINT_DATA_OFFSET;
+    header.data_size = data_size;
+    header.prog_size_bytes = BF_PROG_SIZE_BYTES;
+    header.testcase_fingerprint = _testcase_fingerprint();
+    pcg32_get_state(&header.rng_state, &header.rng_inc);
+
+    header.max_program_size = config->max_program_size;
+    header.elitism = config->elitism;
+    header.crossover = config->crossover;
+    header.mutation = config->mutation;
+    header.population_size = config->population_size;
+    header.num_optimization_gens = config->num_optimization_gens;
+    header.always_penalize_length = config->always_penalize_length;
+
+    header.active_pop_index = _active_pop_index;
+    header.generation = _generation;
+    header.optimizing = optimizing;
+    header.optgen_count = optgen_count;
+
+    header.initial_elitism = _initial_elitism;
+    header.initial_crossover = _initial_crossover;
+    header.initial_mutation = _initial_mutation;
+    header.last_improved_gen = _last_improved_gen;
+    header.max_population_size = _max_population_size;
+    memcpy(header.mutation_trials, _mutation_trials, sizeof(_mutation_trials));
+    memcpy(header.mutation_successes, _mutation_successes, sizeof(_mutation_successes));
+
+    if (sync)
+    {
+        return checkpoint_write_sync(&header, _population);
+    }
+
+    return (checkpoint_write_async(&header, _population) < 0) ? -1 : 0;
+}
+
+// Write a single JSON telemetry record describing the active population, and
+// the programs assessed since the last record
+static void _write_telemetry(evolution_config_t *config, bool optimizing, uint32_t num_gens,
+                             uint64_t elapsed_ns)
+{
+    uint64_t total_len = 0u;
+
+    for (unsigned int i = 0u; i < config->population_size; i++)
+    {
+        total_len += ACTIVE_POP(i)->program_len;
+    }
+
+    double elapsed_s = ((double) MAX_VAL(elapsed_ns, 1u)) / 1e9;
+    double assessed = (double) MAX_VAL(_num_assessed, 1u);
+
+    fprintf(_telemetry_fp, "{\"gen\":%u,\"stage\":%d,\"programs\":%llu,"
+            "\"programs_per_sec\":%.1f,\"best_fitness\":%u,\"median_fitness\":%u,"
+            "\"worst_fitness\":%u,\"mean_program_len\":%.2f,\"invalid_share\":%.4f,"
+            "\"timeout_share\":%.4f,\"gen_ms\":%.3f,\"elitism\":%.3f,\"crossover\":%.3f,"
+            "\"mutation\":%.3f",
+            _generation, ((int) optimizing) + 1, (unsigned long long) _num_assessed,
+            ((double) _num_assessed) / elapsed_s, ACTIVE_POP(0)->fitness,
+            ACTIVE_POP(config->population_size / 2u)->fitness,
+            ACTIVE_POP(config->population_size - 1u)->fitness,
+            ((double) total_len) / ((double) config->population_size),
+            ((double) _num_invalid) / assessed, ((double) _num_timeouts) / assessed,
+            (((double) elapsed_ns) / 1e6) / ((double) MAX_VAL(num_gens, 1u)),
+            config->elitism, config->crossover, config->mutation);
+
+    if (config->deduplicate)
+    {
+        fprintf(_telemetry_fp, ",\"duplicate_share\":%.4f",
+                ((double) _num_duplicates) / ((double) MAX_VAL(_num_dedup_checked, 1u)));
+    }
+
+    fprintf(_telemetry_fp, "}\n");
+    fflush(_telemetry_fp);
+
+    _num_assessed = 0u;
+    _num_invalid = 0u;
+    _num_timeouts = 0u;
+    _num_dedup_checked = 0u;
+    _num_duplicates = 0u;
+}
+
+// Share of distinct fitness values among the elite items of the active population
+// (0.0 - 1.0). Population must be sorted.
+static float _elite_diversity(evolution_config_t *config)
+{
+    uint32_t distinct = 1u;
+
+    for (uint32_t i = 1u; i < _elite_border; i++)
+    {
+        distinct += (ACTIVE_POP(i)->fitness != ACTIVE_POP(i - 1u)->fitness);
+    }
+
+    return ((float) distinct) / ((float) MAX_VAL(_elite_border, 1u));
+}
+
+// Share of elite items in the active population that have the same fitness as the
+// fittest item (0.0 - 1.0). Population must be sorted.
+static float _converged_share(evolution_config_t *config)
+{
+    uint32_t same = 0u;
+
+    while ((same < _elite_border) && (ACTIVE_POP(same)->fitness == ACTIVE_POP(0)->fitness))
+    {
+        same++;
+    }
+
+    return ((float) same) / ((float) MAX_VAL(_elite_border, 1u));
+}
+
+// Share of the active population that passes at least one test case without
+// the BF interpreter failing. Population must be sorted.
+static float _viable_share(evolution_config_t *config)
+{
+    uint32_t failed_fitness = UINT32_MAX / _num_testcases;
+    uint32_t viable = 0u;
+
+    while ((viable < config->population_size) && (ACTIVE_POP(viable)->fitness < failed_fitness))
+    {
+        viable++;
+    }
+
+    return ((float) viable) / ((float) config->population_size);
+}
+
+static float _clamp_rate(float rate, float max)
+{
+    return MIN_VAL(MAX_VAL(rate, ADAPT_MIN_RATE), max);
+}
+
+// Adjust elitism, crossover and mutation based on the improvement rate of the last
+// generation and the diversity of the active population
+static void _adapt_rates(evolution_config_t *config)
+{
+    float improvement = ((float) _children_improved) / ((float) MAX_VAL(_children_assessed, 1u));
+
+    // Mutate more when new BF programs rarely improve on their parents, and less
+    // when they often do (similar to the "1/5th success rule")
+    if (improvement >= ADAPT_TARGET_IMPROVEMENT)
+    {
+        config->mutation /= ADAPT_STEP;
+    }
+    else
+    {
+        config->mutation *= ADAPT_STEP;
+    }
+
+    if (_elite_diversity(config) < ADAPT_MIN_DIVERSITY)
+    {
+        // Elite items are mostly clones; select more broadly, and breed less, since
+        // breeding clones together is wasted effort
+        config->elitism *= ADAPT_STEP;
+        config->crossover /= ADAPT_STEP;
+    }
+    else
+    {
+        // Elite items are diverse; select more narrowly, and breed more
+        config->elitism /= ADAPT_STEP;
+        config->crossover *= ADAPT_STEP;
+    }
+
+    // Selecting BF programs that fail every test case is wasted effort
+    float max_elitism = MAX_VAL(MIN_VAL(ADAPT_MAX_ELITISM, _viable_share(config)), ADAPT_MIN_RATE);
+
+    config->elitism = _clamp_rate(config->elitism, max_elitism);
+    config->crossover = _clamp_rate(config->crossover, 1.0f);
+    config->mutation = _clamp_rate(config->mutation, 1.0f);
+
+    _elite_border = (unsigned int) (((float) config->population_size) * config->elitism);
+}
+
 // Uses qsort to sort the entire population based on fitness
 static void _sort_active_population(evolution_config_t *config)
 {
     qsort(ACTIVE_POP(0), config->population_size, BF_PROG_SIZE_BYTES, _cmporgs);
 }
 
-// Assess the fitness of a BF program by running all provided test cases.
-// Lower scores are better, 0 is a perfect score.
+// Failure rate of a test case, test cases with no statistics yet count as always failing
+static float _testcase_fail_rate(unsigned int i)
+{
+    return (0.0f < _testcase_runs[i]) ? (_testcase_fails[i] / _testcase_runs[i]) : 1.0f;
+}
+
+// qsort compare function to sort test case indices by failure rate, highest first
+static int _cmptestcases(const void *a, const void *b)
+{
+    float ra = _testcase_fail_rate(*((const unsigned int *) a));
+    float rb = _testcase_fail_rate(*((const unsigned int *) b));
+
+    return (ra < rb) - (ra > rb);
+}
+
+// Decay test case failure statistics, re-order test cases so that the ones which
+// fail most often run first, and set the early abort threshold for this generation
+static void _order_testcases(evolution_config_t *config)
+{
+    for (unsigned int i = 0u; i < _num_testcases; i++)
+    {
+        _testcase_runs[i] *= TESTCASE_STATS_DECAY;
+        _testcase_fails[i] *= TESTCASE_STATS_DECAY;
+    }
+
+    qsort(_testcase_order, _num_testcases, sizeof(unsigned int), _cmptestcases);
+
+    // Lexicase selection needs errors for every test case
+    if ((0u < _elite_border) && (SELECTION_TOURNAMENT == config->selection))
+    {
+        _abort_fitness = ACTIVE_POP(_elite_border - 1u)->fitness;
+    }
+}
+
+// Record the error of a BF program on a single test case
+static void _record_error(bf_program_t *prog, unsigned int i, uint32_t error)
+{
+    if (0u < _errors_size)
+    {
+        BF_PROG_ERRORS(prog)[i] = error;
+    }
+
+    if (NULL != _testcase_order)
+    {
+        _testcase_runs[i] += 1.0f;
+        _testcase_fails[i] += (float) (0u < error);
+    }
+}
+
+/* Find the '.' to blame for the first difference between the output of a BF
+ * program and the expected output of a test case, from the output trace */
+static uint32_t _find_blame(const evolution_testcase_t *testcase, const char *output, size_t len)
+{
+    size_t smallest_size = MIN_VAL(testcase->output_size, len);
+    size_t k = 0u;
+
+    while ((k < smallest_size) && (testcase->output[k] == output[k]))
+    {
+        k++;
+    }
+
+    if (k < len)
+    {
+        // Wrong character, or one character too many
+        return (uint32_t) _trace[k];
+    }
+
+    if (k < testcase->output_size)
+    {
+        // Too few characters, so the next one should be printed after the last '.'
+        return ((uint32_t) _trace[len - 1u]) + 1u;
+    }
+
+    return BLAME_NONE;
+}
+
+/* Make the output trace of the unlocked part of a BF program, which starts at
+ * output character 'offset', relative to the start of the whole BF program. The
+ * locked prefix ends with the '.' that printed the character before 'offset'. */
+static void _rebase_trace(size_t offset, size_t len)
+{
+    if (0u < offset)
+    {
+        _trace[offset - 1u] = (int) (_locked_len - 1u);
+    }
+
+    for (size_t k = offset; k < len; k++)
+    {
+        _trace[k] += (int) _locked_len;
+    }
+}
+
+/* Assess the fitness of a BF program by running all provided test cases, or only
+ * the current subset of test cases if subsampling. Lower scores are better, 0 is
+ * a perfect score. If assessment is stopped early by _abort_fitness, the returned
+ * fitness is only a lower bound. If a prefix is locked, only the rest of the BF
+ * program is run, starting from where the locked prefix left off. */
 static uint32_t _assess_bf_program(bf_program_t *prog, bool penalize_length)
 {
     uint32_t fitness = 0u;
+    bool invalid = false;
+    bool timeout = false;
 
-    for (unsigned int i = 0u; i < _num_testcases; i++)
+    unsigned int num_testcases = (0u < _subset_size) ? _subset_size : _num_testcases;
+    char *text = prog->text + _locked_len;
+
+    /* Most BF programs fail on the first test case, and compiling costs about as
+     * much as interpreting once, so BF programs are only compiled (once, for all
+     * remaining test cases) after producing the exact expected output for the
+     * first test case */
+    int code_len = BF_ERR_INVALID;
+    bool compiled = false;
+
+    prog->blame = BLAME_NONE;
+    bf_trace_output(_trace);
+
+    for (unsigned int t = 0u; (t < num_testcases) && (fitness <= _abort_fitness); t++)
     {
-        char output[MAX_TESTCASE_OUTPUT_SIZE];
-        int len = bf_interpret(prog->text, _testcases[i].input, _testcases[i].input_size,
-                               output, MAX_TESTCASE_OUTPUT_SIZE - 1u, MAX_INSTRUCTIONS_EXEC);
+        unsigned int i;
 
-        if (len <= 0)
+        if (0u < _subset_size)
         {
-            fitness += UINT32_MAX / _num_testcases;
-            continue;
+            i = _subset[t];
+        }
+        else
+        {
+            i = (NULL == _testcase_order) ? t : _testcase_order[t];
         }
 
-        // Null-terminate the output
-        output[len] = 0;
+        char *output = _output;
+        const evolution_testcase_t *testcase = &_testcases[i];
+        const bf_state_t *start = _start_state;
+        size_t input_offset = 0u;
+        size_t output_offset = 0u;
+        int max_instructions = MAX_INSTRUCTIONS_EXEC;
+        uint32_t error = 0u;
+        int len;
 
-        /* Add a penalty for every character too many/too few that the BF
-         * program generates */
-        if (_testcases[i].output_size != len)
+        if (0u < _locked_len)
         {
-            uint32_t diff = (uint32_t) abs(((int) _testcases[i].output_size) - len);
-            uint32_t fitness_add = (diff * 1000000u);
-            if (fitness <= (UINT32_MAX - fitness_add))
-            {
-                fitness += fitness_add;
-            }
-            else
+            // Output of the locked prefix always matches the start of the expected output
+            start = &_locks[i].state;
+            input_offset = _locks[i].input_offset;
+            output_offset = _locks[i].output_offset;
+            max_instructions -= _locks[i].instructions;
+            memcpy(output, testcase->output, output_offset);
+
+            if (NULL != _trace)
             {
-                fitness = UINT32_MAX;
+                bf_trace_output(_trace + output_offset);
             }
         }
 
-        /* Add a penalty for each character in the output generated by BF program
-         * that differs from the character at the same index in the desired
-         * output string from the test case */
-        int smallest_size = MINVAL(_testcases[i].output_size, len);
-        for (int j = 0; j < smallest_size; j++)
+        if (0 <= code_len)
         {
-            char a = _testcases[i].output[j];
-            char b = output[j];
-            //uint32_t fitness_add = (uint32_t) (abs(a - b) * ((smallest_size - j) + 1)) * 1000u;
-            uint32_t fitness_add = (uint32_t) (abs(a - b) * 1000u);
-            if (fitness <= (UINT32_MAX - fitness_add))
-            {
-                fitness += fitness_add;
-            }
-            else
+            len = bf_execute_ex(_code, code_len, testcase->input + input_offset,
+                                testcase->input_size - input_offset, output + output_offset,
+                                (testcase->output_size + MAX_EXTRA_OUTPUT) - output_offset,
+                                max_instructions, start, NULL);
+        }
+        else
+        {
+            len = bf_interpret_ex(text, testcase->input + input_offset,
+                                  testcase->input_size - input_offset, output + output_offset,
+                                  (testcase->output_size + MAX_EXTRA_OUTPUT) - output_offset,
+                                  max_instructions, start, NULL);
+        }
+
+        if (0 <= len)
+        {
+            len += (int) output_offset;
+        }
+
+        if (len <= 0)
+        {
+            invalid |= (BF_ERR_INVALID == len);
+            timeout |= (BF_ERR_TIMEOUT == len);
+            error = UINT32_MAX / _num_testcases;
+            fitness += error;
+            _record_error(prog, i, error);
+            continue;
+        }
+
+        // Compare the output against the desired output, using the configured metric
+        error = fitness_assess(testcase->output, testcase->output_size, output, len);
+
+        if (!compiled && (0u == error) && ((t + 1u) < num_testcases))
+        {
+            code_len = bf_compile(text, _code, _max_code);
+            compiled = true;
+        }
+
+        if ((NULL != _trace) && (0u < error) && (BLAME_NONE == prog->blame))
+        {
+            if (0u < _locked_len)
             {
-                fitness = UINT32_MAX;
+                _rebase_trace(output_offset, (size_t) len);
             }
+
+            prog->blame = _find_blame(testcase, output, (size_t) len);
+        }
+
+        if (fitness <= (UINT32_MAX - error))
+        {
+            fitness += error;
+        }
+        else
+        {
+            fitness = UINT32_MAX;
         }
+
+        _record_error(prog, i, error);
+    }
+
+    bf_trace_output(NULL);
+
+    // Scale up to estimate fitness on all test cases
+    prog->sampled = (0u < _subset_size);
+    if (prog->sampled)
+    {
+        uint64_t estimate = (((uint64_t) fitness) * _num_testcases) / _subset_size;
+        fitness = (uint32_t) MIN_VAL(estimate, UINT32_MAX);
     }
 
     if (penalize_length && (fitness <= (UINT32_MAX - prog->program_len)))
@@ -207,9 +787,60 @@ static uint32_t _assess_bf_program(bf_program_t *prog, bool penalize_length)
         fitness += prog->program_len;
     }
 
+    _num_assessed++;
+    _num_timeouts += timeout;
+    _num_invalid += (invalid && !timeout);
+
     return fitness;
 }
 
+// Draw a new random subset of test cases to assess new BF programs on
+static void _draw_subset(void)
+{
+    // Partial shuffle; _subset always holds every test case exactly once
+    for (unsigned int t = 0u; t < _subset_size; t++)
+    {
+        unsigned int j = randrange(t, _num_testcases - 1u);
+        unsigned int tmp = _subset[t];
+        _subset[t] = _subset[j];
+        _subset[j] = tmp;
+    }
+
+    if (NULL != _testcase_order)
+    {
+        qsort(_subset, _subset_size, sizeof(unsigned int), _cmptestcases);
+    }
+}
+
+/* Re-assess elite BF programs whose fitness was estimated from a subset of test
+ * cases on all test cases, and re-sort, until the elite (and so the fittest BF
+ * program) contains only fully assessed BF programs */
+static void _rescore_elite(evolution_config_t *config)
+{
+    uint32_t border = MAX_VAL(_elite_border, 1u);
+    bool rescored = true;
+
+    while (rescored)
+    {
+        rescored = false;
+
+        for (uint32_t i = 0u; i < border; i++)
+        {
+            bf_program_t *prog = ACTIVE_POP(i);
+            if (prog->sampled)
+            {
+                prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+                rescored = true;
+            }
+        }
+
+        if (rescored)
+        {
+            _sort_active_population(config);
+        }
+    }
+}
+
 // Return the fittest of #TOURNAMENT_SIZE randomly selected organisms
 static bf_program_t *_tournament(evolution_config_t *config)
 {
@@ -236,46 +867,371 @@ static bf_program_t *_tournament(evolution_config_t *config)
     return best;
 }
 
-// Create 2 new BF programs by randomly combining slices from 2 existing BF programs
-static int _breed(evolution_config_t *config, bf_program_t *p1, bf_program_t *p2,
-                  bf_program_t *c1, bf_program_t *c2)
+// qsort compare function to sort error values
+static int _cmperrors(const void *a, const void *b)
 {
-    /* Split each parent randomly between the 1st and 3rd quarter */
-    uint32_t p1i = randrange(p1->program_len / 4u, (p1->program_len / 4u) * 3u);
-    uint32_t p2i = randrange(p2->program_len / 4u, (p2->program_len / 4u) * 3u);
-
-    /* Copy 1st half of p1 to 1st half of c1 */
-    memcpy(c1->text, p1->text, p1i);
-    c1->program_len = p1i;
-
-    /* Copy 2nd half of p2 to 2nd half of c1 */
-    size_t copy_size = MINVAL(config->max_program_size - c1->program_len, p2->program_len - p2i);
-    memcpy(c1->text + p1i, p2->text + p2i, copy_size);
-    c1->program_len += copy_size;
+    uint32_t ea = *((const uint32_t *) a);
+    uint32_t eb = *((const uint32_t *) b);
 
-    /* Copy 1st half of p2 to 1st half of c2 */
-    memcpy(c2->text, p2->text, p2i);
-    c2->program_len = p2i;
+    return (ea > eb) - (ea < eb);
+}
 
-    /* Copy 2nd half of p1 to 2nd half of c2 */
-    copy_size = MINVAL(config->max_program_size - c2->program_len, p1->program_len - p1i);
-    memcpy(c2->text + p2i, p1->text + p1i, copy_size);
-    c2->program_len += copy_size;
+// Find the median of a list of error values. The list is sorted in place.
+static uint32_t _median_error(uint32_t *errors, uint32_t count)
+{
+    qsort(errors, count, sizeof(uint32_t), _cmperrors);
+    return errors[count / 2u];
+}
 
-    // Make sure both new programs are at least BF_MIN_PROG_SIZE
-    if (BF_MIN_PROG_SIZE > c1->program_len)
+/* Copy the per-test-case errors of the active population into the lexicase
+ * workspace, so that selection scans contiguous memory, and calculate the
+ * epsilon-lexicase tolerance for each test case */
+static int _prepare_lexicase(evolution_config_t *config)
+{
+    if (config->population_size > _lexicase_capacity)
     {
-        int added = bf_rand_syms(c1->text + c1->program_len,
-                                 BF_MIN_PROG_SIZE - c1->program_len, -1);
-        if (added <= 0)
+        size_t count = (((size_t) config->population_size) * (_num_testcases + 1u)) + (2u * _num_testcases);
+        uint32_t *buf = realloc(_lexicase_buf, count * sizeof(uint32_t));
+        if (NULL == buf)
         {
-            bfi_log("failed to generate random BF characters");
+            bfi_log("Failed to allocate memory");
             return -1;
         }
-        c1->program_len += added;
+
+        _lexicase_buf = buf;
+        _lexicase_capacity = config->population_size;
     }
 
-    if (BF_MIN_PROG_SIZE > c2->program_len)
+    _lexicase_errors = _lexicase_buf;
+    _lexicase_pool = _lexicase_errors + (config->population_size * _num_testcases);
+    _lexicase_cases = _lexicase_pool + config->population_size;
+    _lexicase_epsilon = _lexicase_cases + _num_testcases;
+
+    for (uint32_t i = 0u; i < config->population_size; i++)
+    {
+        uint32_t *errors = BF_PROG_ERRORS(ACTIVE_POP(i));
+
+        for (uint32_t t = 0u; t < _num_testcases; t++)
+        {
+            _lexicase_errors[(t * config->population_size) + i] = errors[t];
+        }
+    }
+
+    for (uint32_t t = 0u; t < _num_testcases; t++)
+    {
+        _lexicase_epsilon[t] = 0u;
+
+        if (SELECTION_EPSILON_LEXICASE != config->selection)
+        {
+            continue;
+        }
+
+        // Median absolute deviation; candidate pool is free to use as scratch space here
+        uint32_t *errors = &_lexicase_errors[t * config->population_size];
+        memcpy(_lexicase_pool, errors, config->population_size * sizeof(uint32_t));
+        uint32_t median = _median_error(_lexicase_pool, config->population_size);
+
+        for (uint32_t i = 0u; i < config->population_size; i++)
+        {
+            _lexicase_pool[i] = (errors[i] > median) ? (errors[i] - median) : (median - errors[i]);
+        }
+
+        _lexicase_epsilon[t] = _median_error(_lexicase_pool, config->population_size);
+    }
+
+    return 0;
+}
+
+/* Select a BF program by (epsilon-)lexicase selection; starting with the whole
+ * population, go through test cases in random order, and keep only the BF programs
+ * with the lowest error for each one, until one is left or test cases run out.
+ * The BF program at index 'exclude' in the active population is never selected. */
+static bf_program_t *_lexicase(evolution_config_t *config, uint32_t exclude)
+{
+    uint32_t num_candidates = 0u;
+
+    for (uint32_t i = 0u; i < config->population_size; i++)
+    {
+        if (i != exclude)
+        {
+            _lexicase_pool[num_candidates++] = i;
+        }
+    }
+
+    if (0u == num_candidates)
+    {
+        return ACTIVE_POP(exclude);
+    }
+
+    // Shuffle test case order
+    for (uint32_t t = 0u; t < _num_testcases; t++)
+    {
+        _lexicase_cases[t] = t;
+    }
+
+    for (uint32_t t = _num_testcases - 1u; t > 0u; t--)
+    {
+        uint32_t j = randrange(0u, t);
+        uint32_t tmp = _lexicase_cases[t];
+        _lexicase_cases[t] = _lexicase_cases[j];
+        _lexicase_cases[j] = tmp;
+    }
+
+    for (uint32_t t = 0u; (t < _num_testcases) && (1u < num_candidates); t++)
+    {
+        uint32_t testcase = _lexicase_cases[t];
+        uint32_t *errors = &_lexicase_errors[testcase * config->population_size];
+        uint32_t best = UINT32_MAX;
+
+        for (uint32_t i = 0u; i < num_candidates; i++)
+        {
+            best = MIN_VAL(best, errors[_lexicase_pool[i]]);
+        }
+
+        uint32_t epsilon = _lexicase_epsilon[testcase];
+        uint32_t limit = (best <= (UINT32_MAX - epsilon)) ? (best + epsilon) : UINT32_MAX;
+        uint32_t kept = 0u;
+
+        for (uint32_t i = 0u; i < num_candidates; i++)
+        {
+            if (errors[_lexicase_pool[i]] <= limit)
+            {
+                _lexicase_pool[kept++] = _lexicase_pool[i];
+            }
+        }
+
+        num_candidates = kept;
+    }
+
+    return ACTIVE_POP(_lexicase_pool[randrange(0u, num_candidates - 1u)]);
+}
+
+// Loop depth of a BF program before the character at index i
+static int _depth_at(const bf_program_t *prog, uint32_t i)
+{
+    int depth = 0;
+
+    for (uint32_t j = 0u; j < i; j++)
+    {
+        depth += (prog->text[j] == '[') - (prog->text[j] == ']');
+    }
+
+    return depth;
+}
+
+/* Pick a random index between 'low' and 'high' at which a BF program is at loop
+ * depth 'depth', or return 'fallback' if there is no such index */
+static uint32_t _cut_at_depth(const bf_program_t *prog, uint32_t low, uint32_t high, int depth,
+                              uint32_t fallback)
+{
+    int d = _depth_at(prog, low);
+    uint32_t num_found = 0u;
+    uint32_t cut = fallback;
+
+    for (uint32_t i = low; i <= high; i++)
+    {
+        // Reservoir sampling, so each index at the right depth is equally likely
+        if ((d == depth) && (0u == randrange(0u, num_found++)))
+        {
+            cut = i;
+        }
+
+        d += (prog->text[i] == '[') - (prog->text[i] == ']');
+    }
+
+    return cut;
+}
+
+/* Remove unmatched '[' and ']' characters from a BF program, so that all of its
+ * brackets are balanced */
+static void _repair_brackets(bf_program_t *org)
+{
+    size_t original_len = org->program_len;
+    size_t len = 0u;
+    int depth = 0;
+
+    // Drop every ']' that has no '[' before it to close
+    for (size_t i = 0u; i < org->program_len; i++)
+    {
+        char c = org->text[i];
+
+        if (c == ']')
+        {
+            if (0 == depth)
+            {
+                continue;
+            }
+
+            depth--;
+        }
+
+        depth += (c == '[');
+        org->text[len++] = c;
+    }
+
+    // Drop the last 'depth' '[' characters that have no ']' after them to close
+    int closing = 0;
+    size_t i = len;
+
+    while ((0 < depth) && (0u < i))
+    {
+        i--;
+
+        if (org->text[i] == ']')
+        {
+            closing++;
+        }
+        else if ((org->text[i] == '[') && (0 < closing))
+        {
+            closing--;
+        }
+        else if (org->text[i] == '[')
+        {
+            memmove(org->text + i, org->text + i + 1u, len - (i + 1u));
+            len--;
+            depth--;
+        }
+    }
+
+    // Dropped brackets may have moved the blamed '.'
+    if (len != original_len)
+    {
+        org->blame = BLAME_NONE;
+    }
+
+    // Make sure the BF program is at least BF_MIN_PROG_SIZE, without adding brackets
+    while (BF_MIN_PROG_SIZE > len)
+    {
+        char c = bf_rand_sym();
+
+        if ((c != '[') && (c != ']'))
+        {
+            org->text[len++] = c;
+        }
+    }
+
+    org->program_len = len;
+    org->text[len] = 0;
+}
+
+/* Insert a '[' at index i, and a matching ']' at a random index after it, such
+ * that the characters between them have balanced brackets */
+static void _insert_bracket_pair(evolution_config_t *config, bf_program_t *org, uint32_t i)
+{
+    if ((org->program_len + 2u) > config->max_program_size)
+    {
+        return;
+    }
+
+    uint32_t num_found = 0u;
+    uint32_t end = i;
+    int depth = 0;
+
+    for (uint32_t j = i + 1u; (j <= org->program_len) && (0 <= depth); j++)
+    {
+        depth += (org->text[j - 1u] == '[') - (org->text[j - 1u] == ']');
+
+        // Reservoir sampling over every index that closes a balanced slice
+        if ((0 == depth) && (0u == randrange(0u, num_found++)))
+        {
+            end = j;
+        }
+    }
+
+    memmove(org->text + end + 2u, org->text + end, org->program_len - end);
+    org->text[end + 1u] = ']';
+
+    memmove(org->text + i + 1u, org->text + i, end - i);
+    org->text[i] = '[';
+
+    org->program_len += 2u;
+    org->text[org->program_len] = 0;
+}
+
+// Copy the part of a BF program after the locked prefix to a scratch BF program
+static bf_program_t *_unlocked_part(const bf_program_t *prog, unsigned int part_index)
+{
+    bf_program_t *part = _lock_parts[part_index];
+
+    part->fitness = prog->fitness;
+    part->blame = ((BLAME_NONE == prog->blame) || (prog->blame < _locked_len)) ?
+                  BLAME_NONE : (prog->blame - _locked_len);
+    part->program_len = prog->program_len - _locked_len;
+    memcpy(part->text, prog->text + _locked_len, part->program_len + 1u);
+
+    return part;
+}
+
+// Set a BF program to the locked prefix, followed by a scratch BF program
+static void _join_unlocked_part(bf_program_t *prog, const bf_program_t *part)
+{
+    memcpy(prog->text, _lock_prefix, _locked_len);
+    memcpy(prog->text + _locked_len, part->text, part->program_len + 1u);
+    prog->program_len = _locked_len + part->program_len;
+    prog->blame = (BLAME_NONE == part->blame) ? BLAME_NONE : (_locked_len + part->blame);
+}
+
+// Config for variation of the unlocked parts of BF programs
+static evolution_config_t _unlocked_config(const evolution_config_t *config)
+{
+    evolution_config_t unlocked = *config;
+    unlocked.max_program_size -= _locked_len;
+    return unlocked;
+}
+
+// Create 2 new BF programs by randomly combining slices from 2 existing BF programs
+static int _crossover(evolution_config_t *config, bf_program_t *p1, bf_program_t *p2,
+                      bf_program_t *c1, bf_program_t *c2)
+{
+    /* Split each parent randomly between the 1st and 3rd quarter */
+    uint32_t p1i = randrange(p1->program_len / 4u, (p1->program_len / 4u) * 3u);
+    uint32_t p2i = randrange(p2->program_len / 4u, (p2->program_len / 4u) * 3u);
+
+    /* Split the 2nd parent at the same loop depth as the 1st parent, so that
+     * balanced parents give balanced children */
+    if (config->preserve_brackets)
+    {
+        p2i = _cut_at_depth(p2, p2->program_len / 4u, (p2->program_len / 4u) * 3u,
+                            _depth_at(p1, p1i), p2i);
+    }
+
+    /* Copy 1st half of p1 to 1st half of c1 */
+    memcpy(c1->text, p1->text, p1i);
+    c1->program_len = p1i;
+
+    /* Each child keeps the blamed '.' of the parent it got its 1st half from,
+     * if the '.' is in that half */
+    c1->blame = (p1->blame < p1i) ? p1->blame : BLAME_NONE;
+    c2->blame = (p2->blame < p2i) ? p2->blame : BLAME_NONE;
+
+    /* Copy 2nd half of p2 to 2nd half of c1 */
+    size_t copy_size = MINVAL(config->max_program_size - c1->program_len, p2->program_len - p2i);
+    memcpy(c1->text + p1i, p2->text + p2i, copy_size);
+    c1->program_len += copy_size;
+
+    /* Copy 1st half of p2 to 1st half of c2 */
+    memcpy(c2->text, p2->text, p2i);
+    c2->program_len = p2i;
+
+    /* Copy 2nd half of p1 to 2nd half of c2 */
+    copy_size = MINVAL(config->max_program_size - c2->program_len, p1->program_len - p1i);
+    memcpy(c2->text + p2i, p1->text + p1i, copy_size);
+    c2->program_len += copy_size;
+
+    // Make sure both new programs are at least BF_MIN_PROG_SIZE
+    if (BF_MIN_PROG_SIZE > c1->program_len)
+    {
+        int added = bf_rand_syms(c1->text + c1->program_len,
+                                 BF_MIN_PROG_SIZE - c1->program_len, -1);
+        if (added <= 0)
+        {
+            bfi_log("failed to generate random BF characters");
+            return -1;
+        }
+        c1->program_len += added;
+    }
+
+    if (BF_MIN_PROG_SIZE > c2->program_len)
     {
         int added = bf_rand_syms(c2->text + c2->program_len,
                                  BF_MIN_PROG_SIZE - c2->program_len, -1);
@@ -290,6 +1246,35 @@ static int _breed(evolution_config_t *config, bf_program_t *p1, bf_program_t *p2
     c1->text[c1->program_len] = 0;
     c2->text[c2->program_len] = 0;
 
+    if (config->preserve_brackets)
+    {
+        _repair_brackets(c1);
+        _repair_brackets(c2);
+    }
+
+    return 0;
+}
+
+// Same as _crossover, but leaves the locked prefix of both BF programs untouched
+static int _breed(evolution_config_t *config, bf_program_t *p1, bf_program_t *p2,
+                  bf_program_t *c1, bf_program_t *c2)
+{
+    if (0u == _locked_len)
+    {
+        return _crossover(config, p1, p2, c1, c2);
+    }
+
+    evolution_config_t unlocked_config = _unlocked_config(config);
+
+    if (_crossover(&unlocked_config, _unlocked_part(p1, 0u), _unlocked_part(p2, 1u),
+                   _lock_parts[2], _lock_parts[3]) < 0)
+    {
+        return -1;
+    }
+
+    _join_unlocked_part(c1, _lock_parts[2]);
+    _join_unlocked_part(c2, _lock_parts[3]);
+
     return 0;
 }
 
@@ -357,80 +1342,413 @@ static void _snip_slice(bf_program_t *org, int i, int size)
     org->text[org->program_len] = 0;
 }
 
-static int _mutate(evolution_config_t *config, bf_program_t *org)
+// Re-calculate mutation operator selection probabilities from recent success
+// rates (softmax), and decay the success statistics
+static void _update_mutation_probabilities(void)
 {
-    char buf[MUTATE_STR_SIZE];
-    int size;
-    uint32_t randlen;
-
-    uint32_t j;
-    uint32_t i = randrange(1u, org->program_len);
-    uint32_t m = randrange(0u, NUM_MUTATIONS - 1u);
-    char c;
+    float rates[NUM_MUTATIONS];
+    float mean_rate = 0.0f;
 
-    switch(m)
+    for (uint32_t m = 0u; m < NUM_MUTATIONS; m++)
     {
-        case MUTATE_SWAP:
-        {
-            /* Pick two random characters and swap their positions */
-            uint32_t j = randrange(1, org->program_len);
-            char ci = org->text[i - 1];
-            org->text[i - 1] = org->text[j - 1];
-            org->text[j - 1] = ci;
-        }
-        break;
+        rates[m] = (_mutation_successes[m] + 1.0f) / (_mutation_trials[m] + 1.0f);
+        mean_rate += rates[m] / ((float) NUM_MUTATIONS);
 
-        /* Move a random character to a new location */
-        case MUTATE_MOVE:
-            if (org->program_len <= 2)
-            {
-                // Not enough characters for this mutation
-                break;
-            }
+        _mutation_successes[m] *= MUTATION_STATS_DECAY;
+        _mutation_trials[m] *= MUTATION_STATS_DECAY;
+    }
 
-            j = randrange_except(1u, org->program_len - 1, i - 1);
-            c = org->text[i - 1];
+    float weights[NUM_MUTATIONS];
+    float total_weight = 0.0f;
 
-            _snip_slice(org, i - 1, 1);
+    for (uint32_t m = 0u; m < NUM_MUTATIONS; m++)
+    {
+        weights[m] = expf(((rates[m] / mean_rate) - 1.0f) / MUTATION_TEMPERATURE);
+        total_weight += weights[m];
+    }
 
-            if (_insert_substring(config, org, &c, 1, j - 1) < 0)
-            {
-                // Not enough space to insert, error
-		bfi_log("Not enough space to insert substring");
-                return -1;
-            }
+    float cumulative = 0.0f;
+    for (uint32_t m = 0u; m < NUM_MUTATIONS; m++)
+    {
+        cumulative += ((1.0f - MUTATION_EXPLORE) * (weights[m] / total_weight)) +
+                      (MUTATION_EXPLORE / ((float) NUM_MUTATIONS));
+        _mutation_cdf[m] = cumulative;
+    }
 
-        break;
+    // Make sure rounding errors can't prevent the last operator from being selected
+    _mutation_cdf[NUM_MUTATIONS - 1u] = 1.0f;
+}
 
-        /* Randomly copy a character */
-        case MUTATE_COPY:
-            if ((org->program_len <= 1) || (org->program_len == config->max_program_size))
-            {
-                // Not enough / too many characters for this mutation
-		break;
-            }
+// Select a mutation operator
+static mutation_e _select_mutation(evolution_config_t *config)
+{
+    if (!config->adaptive_mutation)
+    {
+        return (mutation_e) randrange(0u, NUM_MUTATIONS - 1u);
+    }
 
-            j = randrange_except(1, org->program_len, i);
-            c = org->text[i - 1];
+    float r = randfloat();
+    uint32_t m = 0u;
 
-            if (_insert_substring(config, org, &c, 1, j - 1) < 0)
-            {
-                // Not enough space to insert, abort silently
-                return 0;
-            }
+    while ((m < (NUM_MUTATIONS - 1u)) && (r > _mutation_cdf[m]))
+    {
+        m++;
+    }
 
-        break;
+    return (mutation_e) m;
+}
 
-        /* Randomly add a character */
-        case MUTATE_ADD_CHAR:
-            if (org->program_len == config->max_program_size)
-            {
+// Record whether a mutation operator produced a BF program fitter than its parent
+static void _credit_mutation(mutation_e m, uint32_t parent_fitness, uint32_t child_fitness)
+{
+    _mutation_trials[m] += 1.0f;
+
+    if (child_fitness < parent_fitness)
+    {
+        _mutation_successes[m] += 1.0f;
+    }
+}
+
+/* Pick a random index (starting from 1) in an organism's program string to
+ * mutate at. With output credit assignment, the index is picked from the
+ * CREDIT_WINDOW characters up to and including the blamed character, if any. */
+static uint32_t _mutation_index(evolution_config_t *config, const bf_program_t *org)
+{
+    if (config->output_credit && (BLAME_NONE != org->blame))
+    {
+        uint32_t high = MIN_VAL(org->blame + 1u, org->program_len);
+        uint32_t low = (high > CREDIT_WINDOW) ? (high - CREDIT_WINDOW + 1u) : 1u;
+
+        return randrange(low, high);
+    }
+
+    return randrange(1u, org->program_len);
+}
+
+/* Split an organism's program string into runs of identical BF symbols, and
+ * return the number of runs. Like bf_compile, only '+', '-', '<' and '>' are
+ * grouped into runs, so that new runs can be added between any two other symbols. */
+static uint32_t _decode_runs(const bf_program_t *org)
+{
+    uint32_t num_runs = 0u;
+
+    for (size_t i = 0u; i < org->program_len; i++)
+    {
+        char c = org->text[i];
+
+        if ((0u < num_runs) && (_runs[num_runs - 1u].op == c) && (NULL != strchr("+-<>", c)))
+        {
+            _runs[num_runs - 1u].count++;
+        }
+        else
+        {
+            _runs[num_runs].op = c;
+            _runs[num_runs].count = 1u;
+            num_runs++;
+        }
+    }
+
+    return num_runs;
+}
+
+/* Write runs of BF symbols back to an organism's program string. The program
+ * string is left unchanged if the runs are too long or too short. */
+static void _encode_runs(evolution_config_t *config, bf_program_t *org, uint32_t num_runs)
+{
+    size_t len = 0u;
+
+    for (uint32_t r = 0u; r < num_runs; r++)
+    {
+        len += _runs[r].count;
+    }
+
+    if ((BF_MIN_PROG_SIZE > len) || (config->max_program_size < len))
+    {
+        return;
+    }
+
+    char *text = org->text;
+    for (uint32_t r = 0u; r < num_runs; r++)
+    {
+        memset(text, _runs[r].op, _runs[r].count);
+        text += _runs[r].count;
+    }
+
+    org->program_len = len;
+    org->text[len] = 0;
+}
+
+// Insert a run at index i, if there is room, and return the new number of runs
+static uint32_t _insert_run(evolution_config_t *config, uint32_t num_runs, uint32_t i, bf_run_t run)
+{
+    if (num_runs >= config->max_program_size)
+    {
+        return num_runs;
+    }
+
+    memmove(&_runs[i + 1u], &_runs[i], (num_runs - i) * sizeof(bf_run_t));
+    _runs[i] = run;
+
+    return num_runs + 1u;
+}
+
+/* Pick a random run to mutate. With output credit assignment, the run is picked
+ * the same way as _mutation_index picks a character. */
+static uint32_t _mutation_run(evolution_config_t *config, const bf_program_t *org, uint32_t num_runs)
+{
+    if (!config->output_credit)
+    {
+        return randrange(0u, num_runs - 1u);
+    }
+
+    uint32_t pos = _mutation_index(config, org);
+    uint32_t r = 0u;
+
+    // Find the run that holds the character at 'pos'
+    for (uint32_t end = _runs[0].count; (end < pos) && ((r + 1u) < num_runs); end += _runs[r].count)
+    {
+        r++;
+    }
+
+    return r;
+}
+
+// Remove 'size' runs starting at index i, and return the new number of runs
+static uint32_t _remove_runs(uint32_t num_runs, uint32_t i, uint32_t size)
+{
+    memmove(&_runs[i], &_runs[i + size], (num_runs - (i + size)) * sizeof(bf_run_t));
+    return num_runs - size;
+}
+
+// Generate a new random run of BF symbols
+static bf_run_t _random_run(void)
+{
+    bf_run_t run = {bf_rand_sym(), randrange(1u, RUN_MAX_NEW_COUNT)};
+    return run;
+}
+
+/**
+ * Apply a mutation to an organism's program string as a list of runs of
+ * identical BF symbols. Each mutation operator does the same thing as it does
+ * for single characters, but on whole runs, except for MUTATE_CHANGE, which
+ * mostly changes the number of symbols in a run.
+ *
+ * @param org  organism that holds the program string (BF program object)
+ * @param m    mutation operator to apply
+ */
+static void _mutate_runs(evolution_config_t *config, bf_program_t *org, mutation_e m)
+{
+    uint32_t num_runs = _decode_runs(org);
+    uint32_t i = _mutation_run(config, org, num_runs);
+    uint32_t randlen;
+
+    switch (m)
+    {
+        /* Pick two random runs and swap their positions */
+        case MUTATE_SWAP:
+        {
+            uint32_t j = randrange(0u, num_runs - 1u);
+            bf_run_t run = _runs[i];
+            _runs[i] = _runs[j];
+            _runs[j] = run;
+        }
+        break;
+
+        /* Move a random run to a new location */
+        case MUTATE_MOVE:
+            if (num_runs > 2u)
+            {
+                bf_run_t run = _runs[i];
+                num_runs = _remove_runs(num_runs, i, 1u);
+                num_runs = _insert_run(config, num_runs, randrange_except(0u, num_runs, i), run);
+            }
+        break;
+
+        /* Randomly copy a run */
+        case MUTATE_COPY:
+            num_runs = _insert_run(config, num_runs, randrange(0u, num_runs), _runs[i]);
+        break;
+
+        /* Randomly add a run */
+        case MUTATE_ADD_CHAR:
+        {
+            bf_run_t run = _random_run();
+
+            if (config->preserve_brackets && ((run.op == '[') || (run.op == ']')))
+            {
+                // Brackets are added in matching pairs, directly to the program string
+                size_t offset = 0u;
+                for (uint32_t r = 0u; r < i; r++)
+                {
+                    offset += _runs[r].count;
+                }
+
+                _insert_bracket_pair(config, org, offset);
+                return;
+            }
+
+            num_runs = _insert_run(config, num_runs, i, run);
+        }
+        break;
+
+        /* Randomly add some more runs */
+        case MUTATE_ADD_STR:
+            randlen = randrange(1u, RUN_MAX_NEW_RUNS);
+            for (uint32_t count = 0u; count < randlen; count++)
+            {
+                num_runs = _insert_run(config, num_runs, i, _random_run());
+            }
+        break;
+
+        /* Add or remove a few symbols to/from 1-3 random runs, or sometimes
+         * change the symbol of the run instead */
+        case MUTATE_CHANGE:
+            randlen = randrange(1u, 3u);
+            for (uint32_t count = 0u; (count < randlen) && (0u < num_runs); count++)
+            {
+                i = _mutation_run(config, org, num_runs);
+                uint32_t delta = randrange(1u, RUN_MAX_DELTA);
+
+                if (0u == randrange(0u, 3u))
+                {
+                    _runs[i].op = bf_rand_sym();
+                }
+                else if (0u == randrange(0u, 1u))
+                {
+                    _runs[i].count += delta;
+                }
+                else if (_runs[i].count > delta)
+                {
+                    _runs[i].count -= delta;
+                }
+                else
+                {
+                    num_runs = _remove_runs(num_runs, i, 1u);
+                }
+            }
+        break;
+
+        /* Randomly remove 1 or more contiguous runs */
+        case MUTATE_REMOVE_BLOCK:
+            randlen = randrange(1u, MAX_VAL(num_runs / 2u, 1u));
+            i = randrange(0u, num_runs - randlen);
+            num_runs = _remove_runs(num_runs, i, randlen);
+        break;
+
+        /* Randomly remove 1 or more non-contiguous runs from wherever */
+        case MUTATE_REMOVE_RANDOM:
+            randlen = randrange(1u, MAX_VAL(num_runs / 2u, 1u));
+            for (uint32_t count = 0u; (count < randlen) && (1u < num_runs); count++)
+            {
+                num_runs = _remove_runs(num_runs, randrange(0u, num_runs - 1u), 1u);
+            }
+        break;
+
+        default:
+        break;
+    }
+
+    _encode_runs(config, org, num_runs);
+}
+
+/**
+ * Apply a randomly selected mutation to an organism's program string
+ *
+ * @param org       organism that holds the program string (BF program object)
+ * @param mutation  location to store the mutation operator that was applied (may be NULL)
+ */
+static int _apply_mutation(evolution_config_t *config, bf_program_t *org, mutation_e *mutation)
+{
+    char buf[MUTATE_STR_SIZE];
+    int size;
+    uint32_t randlen;
+
+    uint32_t j;
+    uint32_t i = _mutation_index(config, org);
+    mutation_e m = _select_mutation(config);
+    char c;
+
+    if (NULL != mutation)
+    {
+        *mutation = m;
+    }
+
+    if (config->run_length_genome)
+    {
+        _mutate_runs(config, org, m);
+        return 0;
+    }
+
+    switch(m)
+    {
+        case MUTATE_SWAP:
+        {
+            /* Pick two random characters and swap their positions */
+            uint32_t j = randrange(1, org->program_len);
+            char ci = org->text[i - 1];
+            org->text[i - 1] = org->text[j - 1];
+            org->text[j - 1] = ci;
+        }
+        break;
+
+        /* Move a random character to a new location */
+        case MUTATE_MOVE:
+            if (org->program_len <= 2)
+            {
+                // Not enough characters for this mutation
+                break;
+            }
+
+            j = randrange_except(1u, org->program_len - 1, i - 1);
+            c = org->text[i - 1];
+
+            _snip_slice(org, i - 1, 1);
+
+            if (_insert_substring(config, org, &c, 1, j - 1) < 0)
+            {
+                // Not enough space to insert, error
+		bfi_log("Not enough space to insert substring");
+                return -1;
+            }
+
+        break;
+
+        /* Randomly copy a character */
+        case MUTATE_COPY:
+            if ((org->program_len <= 1) || (org->program_len == config->max_program_size))
+            {
+                // Not enough / too many characters for this mutation
+		break;
+            }
+
+            j = randrange_except(1, org->program_len, i);
+            c = org->text[i - 1];
+
+            if (_insert_substring(config, org, &c, 1, j - 1) < 0)
+            {
+                // Not enough space to insert, abort silently
+                return 0;
+            }
+
+        break;
+
+        /* Randomly add a character */
+        case MUTATE_ADD_CHAR:
+            if (org->program_len == config->max_program_size)
+            {
                 // Too many characters for this mutation
 		break;
             }
 
             c = bf_rand_sym();
 
+            if (config->preserve_brackets && ((c == '[') || (c == ']')))
+            {
+                // Brackets are added in matching pairs
+                _insert_bracket_pair(config, org, i - 1);
+                break;
+            }
+
             if (_insert_substring(config, org, &c, 1, i - 1) < 0)
             {
                 // Not enough space to insert, abort silently
@@ -461,7 +1779,7 @@ static int _mutate(evolution_config_t *config, bf_program_t *org)
             randlen = randrange(1u, 10u);
             for (uint32_t count = 0u; count < randlen; count++)
             {
-                i = randrange(1, org->program_len);
+                i = _mutation_index(config, org);
                 org->text[i - 1] = bf_rand_sym();
             }
         break;
@@ -483,9 +1801,533 @@ static int _mutate(evolution_config_t *config, bf_program_t *org)
                 _snip_slice(org, i - 1, 1);
             }
         break;
+
+        default:
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * Apply a randomly selected mutation to an organism's program string, after the
+ * locked prefix, and remove any brackets left unmatched by it if preserving brackets
+ *
+ * @param org       organism that holds the program string (BF program object)
+ * @param mutation  location to store the mutation operator that was applied (may be NULL)
+ */
+static int _mutate(evolution_config_t *config, bf_program_t *org, mutation_e *mutation)
+{
+    evolution_config_t unlocked_config;
+    bf_program_t *target = org;
+
+    if (0u < _locked_len)
+    {
+        unlocked_config = _unlocked_config(config);
+        config = &unlocked_config;
+        target = _unlocked_part(org, 0u);
+    }
+
+    int ret = _apply_mutation(config, target, mutation);
+
+    if ((0 == ret) && config->preserve_brackets)
+    {
+        _repair_brackets(target);
+    }
+
+    if (target != org)
+    {
+        _join_unlocked_part(org, target);
+    }
+
+    // The blamed '.' may have moved, so don't direct further mutations at it
+    org->blame = BLAME_NONE;
+
+    return ret;
+}
+
+// Generate a new random BF program (after the locked prefix) and assess it
+static void _random_bf_program(evolution_config_t *config, bf_program_t *prog)
+{
+    bf_program_t *target = (0u < _locked_len) ? _lock_parts[0] : prog;
+
+    target->program_len = bf_rand_syms(target->text, BF_MIN_PROG_SIZE,
+                                       config->max_program_size - _locked_len);
+
+    if (config->preserve_brackets)
+    {
+        _repair_brackets(target);
+    }
+
+    if (target != prog)
+    {
+        _join_unlocked_part(prog, target);
+    }
+
+    prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+}
+
+// Put the baseline BF program in place of the last BF program in the active population
+static void _insert_baseline_program(evolution_config_t *config)
+{
+    bf_program_t *prog = ACTIVE_POP(config->population_size - 1u);
+
+    prog->program_len = MIN_VAL(strlen(config->baseline_program), config->max_program_size);
+    memcpy(prog->text, config->baseline_program, prog->program_len);
+    prog->text[prog->program_len] = 0;
+    prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+}
+
+/* Fill the active population with seed programs, followed by mutated copies of
+ * them, and assess them all */
+static int _seed_population(evolution_config_t *config)
+{
+    if (config->adaptive_mutation)
+    {
+        _update_mutation_probabilities();
+    }
+
+    for (uint32_t i = 0u; i < config->population_size; i++)
+    {
+        bf_program_t *prog = ACTIVE_POP(i);
+        const char *seed = config->seed_programs[i % config->num_seed_programs];
+
+        prog->program_len = MIN_VAL(strlen(seed), config->max_program_size);
+        memcpy(prog->text, seed, prog->program_len);
+
+        if (BF_MIN_PROG_SIZE > prog->program_len)
+        {
+            int added = bf_rand_syms(prog->text + prog->program_len,
+                                     BF_MIN_PROG_SIZE - prog->program_len, -1);
+            if (added <= 0)
+            {
+                bfi_log("failed to generate random BF characters");
+                return -1;
+            }
+
+            prog->program_len += added;
+        }
+
+        prog->text[prog->program_len] = 0;
+
+        // Keep one exact copy of each seed program
+        if (i >= config->num_seed_programs)
+        {
+            uint32_t num_mutations = randrange(1u, SEED_MAX_MUTATIONS);
+            for (uint32_t j = 0u; j < num_mutations; j++)
+            {
+                if (_mutate(config, prog, NULL) < 0)
+                {
+                    return -1;
+                }
+            }
+        }
+
+        prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+    }
+
+    return 0;
+}
+
+// Apply several mutations to every BF program in the active population, except
+// the fittest one
+static int _hypermutate(evolution_config_t *config)
+{
+    for (uint32_t i = 1u; i < config->population_size; i++)
+    {
+        bf_program_t *prog = ACTIVE_POP(i);
+
+        for (uint32_t j = 0u; j < HYPERMUTATION_COUNT; j++)
+        {
+            if (_mutate(config, prog, NULL) < 0)
+            {
+                return -1;
+            }
+        }
+
+        prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+    }
+
+    return 0;
+}
+
+// Replace the least fit part of the active population with random BF programs
+static void _reseed(evolution_config_t *config)
+{
+    uint32_t keep = config->population_size - (uint32_t) (((float) config->population_size) * RESEED_SHARE);
+
+    for (uint32_t i = MAX_VAL(keep, 1u); i < config->population_size; i++)
+    {
+        _random_bf_program(config, ACTIVE_POP(i));
+    }
+}
+
+/* Point the fitness metric buffer, compiled BF program buffer, run-length genome
+ * buffer, output trace buffer and output buffer at the space after the populations */
+static void _place_scratch_buffers(evolution_config_t *config, size_t alloc_size)
+{
+    uint8_t *scratch = ((uint8_t *) _population) + ALIGN_UP(alloc_size, sizeof(uint64_t));
+
+    fitness_set_metric(config->fitness, scratch, _max_output_size);
+    scratch += _fitness_buffer_size;
+
+    _code = (bf_insn_t *) scratch;
+    scratch += _max_code * sizeof(bf_insn_t);
+
+    _runs = (config->run_length_genome) ? ((bf_run_t *) scratch) : NULL;
+    scratch += (config->run_length_genome) ? (_max_code * sizeof(bf_run_t)) : 0u;
+
+    _trace = (config->output_credit) ? ((int *) scratch) : NULL;
+    scratch += (config->output_credit) ? (_max_trace * sizeof(int)) : 0u;
+
+    _output = (char *) scratch;
+}
+
+// Keep only the fittest BF programs, and fill a new population (double the size
+// of the current one, up to max_population_size) with random BF programs
+static int _restart(evolution_config_t *config, uint32_t max_population_size, size_t *alloc_size)
+{
+    size_t prog_size = BF_PROG_SIZE_BYTES;
+    uint32_t new_population_size = MIN_VAL(config->population_size * 2u, max_population_size);
+    size_t new_alloc_size = ((new_population_size * prog_size) * 2u) + prog_size;
+
+    bf_program_t *new_population = malloc(new_alloc_size + _scratch_size);
+    if (NULL == new_population)
+    {
+        // Not enough memory to grow, restart with the same population size
+        new_population_size = config->population_size;
+        new_alloc_size = *alloc_size;
+        new_population = malloc(new_alloc_size + _scratch_size);
+
+        if (NULL == new_population)
+        {
+            bfi_log("Failed to allocate memory");
+            return -1;
+        }
+    }
+
+    uint32_t keep = MAX_VAL((uint32_t) (((float) config->population_size) * RESTART_KEEP_SHARE), 1u);
+
+    // Fittest programs go at the start of the first population buffer, and the
+    // best item goes at the end, same as the initial allocation
+    memcpy(new_population, ACTIVE_POP(0), prog_size * keep);
+    memcpy(((uint8_t *) new_population) + (prog_size * new_population_size * 2u), _best_item, prog_size);
+
+    free(_population);
+    _population = new_population;
+    _place_scratch_buffers(config, new_alloc_size);
+    _best_item = (bf_program_t *) (((uint8_t *) _population) + (prog_size * new_population_size * 2u));
+    _active_pop_index = 0u;
+    config->population_size = new_population_size;
+    *alloc_size = new_alloc_size;
+
+    for (uint32_t i = keep; i < config->population_size; i++)
+    {
+        _random_bf_program(config, ACTIVE_POP(i));
+    }
+
+    _elite_border = (unsigned int) (((float) config->population_size) * config->elitism);
+
+    return 0;
+}
+
+/* Run the first 'len' characters of a BF program on all test cases, and return
+ * true if they print the start of the expected output for every test case. If
+ * 'lock' is true, the state left behind on each test case is stored in _locks. */
+static bool _prefix_correct(const bf_program_t *prog, size_t len, bool lock)
+{
+    bf_state_t state;
+
+    memcpy(_lock_text, prog->text, len);
+    _lock_text[len] = 0;
+
+    for (unsigned int i = 0u; i < _num_testcases; i++)
+    {
+        bf_state_t *end = (lock) ? &_locks[i].state : &state;
+        int out = bf_interpret_ex(_lock_text, _testcases[i].input, _testcases[i].input_size,
+                                  _output, _testcases[i].output_size, MAX_INSTRUCTIONS_EXEC,
+                                  _start_state, end);
+
+        if ((0 > out) || (0 != memcmp(_output, _testcases[i].output, out)))
+        {
+            return false;
+        }
+
+        if (lock)
+        {
+            _locks[i].input_offset = bf_last_input_count();
+            _locks[i].output_offset = out;
+            _locks[i].instructions = bf_last_instruction_count();
+        }
+    }
+
+    return true;
+}
+
+// Returns true if a BF program starts with the locked prefix, followed by at
+// least BF_MIN_PROG_SIZE more characters
+static bool _has_locked_prefix(const bf_program_t *prog)
+{
+    return ((_locked_len + BF_MIN_PROG_SIZE) <= prog->program_len) &&
+           (0 == memcmp(prog->text, _lock_prefix, _locked_len));
+}
+
+/* Lock the longest prefix of the fittest BF program that ends with a '.' outside
+ * of any loop, and prints the start of the expected output for every test case,
+ * if it is longer than the current locked prefix and was also found at the last
+ * attempt. BF programs that don't start with the new locked prefix are replaced
+ * with mutated copies of elite BF programs that do. Population must be sorted. */
+static int _try_lock(evolution_config_t *config)
+{
+    bf_program_t *best = ACTIVE_POP(0);
+    uint32_t num_cuts = 0u;
+    int depth = 0;
+
+    for (size_t i = 0u; (i + BF_MIN_PROG_SIZE) < best->program_len; i++)
+    {
+        depth += (best->text[i] == '[') - (best->text[i] == ']');
+
+        if ((best->text[i] == '.') && (0 == depth) && (_locked_len <= i))
+        {
+            _lock_cuts[num_cuts++] = (uint32_t) (i + 1u);
+        }
+    }
+
+    /* The output of a prefix is always the start of the output of any longer
+     * prefix, so the longest correct prefix can be found by binary search */
+    uint32_t low = 0u;
+    uint32_t high = num_cuts;
+
+    while (low < high)
+    {
+        uint32_t mid = low + (((high - low) + 1u) / 2u);
+
+        if (_prefix_correct(best, _lock_cuts[mid - 1u], false))
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1u;
+        }
+    }
+
+    size_t len = (0u < low) ? _lock_cuts[low - 1u] : 0u;
+
+    if ((0u == len) || (len != _lock_candidate_len) || (0 != memcmp(best->text, _lock_candidate, len)))
+    {
+        // Not stable yet, try again next time
+        memcpy(_lock_candidate, best->text, len);
+        _lock_candidate_len = len;
+        return 0;
+    }
+
+    (void) _prefix_correct(best, len, true);
+    memcpy(_lock_prefix, best->text, len);
+    _locked_len = len;
+    _lock_candidate_len = 0u;
+
+    for (uint32_t i = 1u; i < config->population_size; i++)
+    {
+        bf_program_t *prog = ACTIVE_POP(i);
+
+        if (!_has_locked_prefix(prog))
+        {
+            bf_program_t *copy = ACTIVE_POP(randrange(0u, MAX_VAL(_elite_border, 1u) - 1u));
+
+            memcpy(prog, _has_locked_prefix(copy) ? copy : best, BF_PROG_SIZE_BYTES);
+
+            if (_mutate(config, prog, NULL) < 0)
+            {
+                return -1;
+            }
+
+            prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+        }
+    }
+
+    _sort_active_population(config);
+
+    return 0;
+}
+
+// Copy a BF program, leaving out 'size' characters starting at index 'i'
+static void _copy_without(bf_program_t *dest, const bf_program_t *src, size_t i, size_t size)
+{
+    memcpy(dest->text, src->text, i);
+    memcpy(dest->text + i, src->text + i + size, src->program_len - (i + size));
+    dest->program_len = src->program_len - size;
+    dest->text[dest->program_len] = 0;
+}
+
+// Returns true if a BF program can replace another one without failing any test cases
+static bool _still_passes(bf_program_t *candidate)
+{
+    _num_bf_programs++;
+    return (BF_MIN_PROG_SIZE <= candidate->program_len) && (0u == _assess_bf_program(candidate, false));
+}
+
+/* Shorten a BF program that passes all test cases, by removing parts of it that
+ * are not needed to pass all test cases. Removes ever smaller chunks (ddmin), and
+ * then single characters until no single character can be removed (1-minimal). */
+static int _minimize(evolution_config_t *config, bf_program_t *prog)
+{
+    bf_program_t *candidate = malloc(BF_PROG_SIZE_BYTES);
+    if (NULL == candidate)
+    {
+        bfi_log("Failed to allocate memory");
+        return -1;
+    }
+
+    size_t granularity = 2u;
+
+    while (!_stopped)
+    {
+        size_t chunk = (prog->program_len + granularity - 1u) / granularity;
+        bool removed = false;
+
+        // Single characters are left for the 1-minimal pass
+        if (1u >= chunk)
+        {
+            break;
+        }
+
+        for (size_t i = 0u; i < prog->program_len; i += chunk)
+        {
+            _copy_without(candidate, prog, i, MIN_VAL(chunk, prog->program_len - i));
+
+            if (_still_passes(candidate))
+            {
+                memcpy(prog->text, candidate->text, candidate->program_len + 1u);
+                prog->program_len = candidate->program_len;
+                granularity = MAX_VAL(granularity - 1u, 2u);
+                removed = true;
+                break;
+            }
+        }
+
+        if (!removed)
+        {
+            granularity = MIN_VAL(granularity * 2u, prog->program_len);
+        }
+    }
+
+    bool removed = true;
+
+    /* Pairs of adjacent characters are tried before single characters, since
+     * pairs like "[]" or "+-" can only be removed together */
+    while (removed && !_stopped)
+    {
+        removed = false;
+
+        for (size_t i = 0u; i < prog->program_len;)
+        {
+            bool passed = false;
+
+            for (size_t size = MIN_VAL(2u, prog->program_len - i); (0u < size) && !passed; size--)
+            {
+                _copy_without(candidate, prog, i, size);
+                passed = _still_passes(candidate);
+            }
+
+            if (passed)
+            {
+                memcpy(prog->text, candidate->text, candidate->program_len + 1u);
+                prog->program_len = candidate->program_len;
+                removed = true;
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+
+    free(candidate);
+    return 0;
+}
+
+// Empty the fingerprint table, making sure it has room for the whole population
+static int _clear_fingerprints(evolution_config_t *config)
+{
+    // Keep the table at most half full, so probing stays short
+    if (_fingerprints_size < (config->population_size * 2u))
+    {
+        size_t size = 1u;
+        while (size < (config->population_size * 2u))
+        {
+            size <<= 1u;
+        }
+
+        free(_fingerprints);
+        _fingerprints = malloc(size * sizeof(uint64_t));
+        _fingerprints_size = (NULL == _fingerprints) ? 0u : size;
+
+        if (NULL == _fingerprints)
+        {
+            bfi_log("Failed to allocate memory");
+            return -1;
+        }
+    }
+
+    memset(_fingerprints, 0, _fingerprints_size * sizeof(uint64_t));
+    return 0;
+}
+
+// Returns true if a BF program is identical to a BF program that is already in
+// the fingerprint table, and adds it to the table if not
+static bool _seen_before(const bf_program_t *prog)
+{
+    uint64_t hash = hash_bytes(prog->text, prog->program_len, HASH_INIT) | 1u;
+    size_t i = hash & (_fingerprints_size - 1u);
+
+    while (0u != _fingerprints[i])
+    {
+        if (hash == _fingerprints[i])
+        {
+            return true;
+        }
+
+        i = (i + 1u) & (_fingerprints_size - 1u);
+    }
+
+    _fingerprints[i] = hash;
+    return false;
+}
+
+/* Mutate a BF program in the next population until it is not identical to any
+ * other BF program in the next population so far, up to DEDUP_MAX_MUTATIONS
+ * times. Returns 1 if the BF program was mutated and needs to be assessed again,
+ * 0 if it was already unique, or -1 if an error occurred. */
+static int _deduplicate(evolution_config_t *config, bf_program_t *prog)
+{
+    _num_dedup_checked++;
+    _total_dedup_checked++;
+
+    if (!_seen_before(prog))
+    {
+        return 0;
     }
 
-    return 0;
+    _num_duplicates++;
+    _total_duplicates++;
+
+    for (uint32_t i = 0u; i < DEDUP_MAX_MUTATIONS; i++)
+    {
+        if (_mutate(config, prog, NULL) < 0)
+        {
+            return -1;
+        }
+
+        if (!_seen_before(prog))
+        {
+            break;
+        }
+    }
+
+    return 1;
 }
 
 // Evolve the active population until the next population is full
@@ -494,9 +2336,43 @@ static int _evolve(evolution_config_t *config)
     uint32_t nextpos = 0;
     uint32_t activepos = 0u;
 
+    _children_assessed = 0u;
+    _children_improved = 0u;
+
+    if (config->adaptive_mutation)
+    {
+        _update_mutation_probabilities();
+    }
+
+    if ((SELECTION_TOURNAMENT != config->selection) && (_prepare_lexicase(config) < 0))
+    {
+        return -1;
+    }
+
+    if (NULL != _testcase_order)
+    {
+        _order_testcases(config);
+    }
+
+    if (NULL != _subset)
+    {
+        _subset_size = config->testcase_subset_size;
+        _draw_subset();
+    }
+
+    if (config->deduplicate && (_clear_fingerprints(config) < 0))
+    {
+        return -1;
+    }
+
     // Always copy over the fittest program
     memcpy(NEXT_POP(nextpos++), ACTIVE_POP(0), BF_PROG_SIZE_BYTES);
 
+    if (config->deduplicate)
+    {
+        (void) _seen_before(NEXT_POP(0));
+    }
+
     for (; activepos < _elite_border; activepos++)
     {
         bool new_items_added = false;
@@ -508,10 +2384,16 @@ static int _evolve(evolution_config_t *config)
         }
 
         /* Pick two elite items; one based on fitness within the overall
-         * population, and one based on fitness with a smaller randomly-selected group */
+         * population, and one based on fitness with a smaller randomly-selected group
+         * (or on per-test-case errors, for lexicase selection) */
         bf_program_t *curr1 = ACTIVE_POP(activepos);
         bf_program_t *curr2 = curr1;
 
+        if (SELECTION_TOURNAMENT != config->selection)
+        {
+            curr2 = _lexicase(config, activepos);
+        }
+
         while (curr1 == curr2)
         {
            curr2 = _tournament(config);
@@ -537,26 +2419,54 @@ static int _evolve(evolution_config_t *config)
             memcpy(next2, curr2, BF_PROG_SIZE_BYTES);
         }
 
+        bool mutated = false;
+        mutation_e mutation1;
+        mutation_e mutation2;
+
         if (randfloat() <= config->mutation)
         {
             // Mutate both new organisms
-            if (_mutate(config, next1) < 0)
+            if (_mutate(config, next1, &mutation1) < 0)
             {
                 return -1;
             }
 
-            if (_mutate(config, next2) < 0)
+            if (_mutate(config, next2, &mutation2) < 0)
             {
                 return -1;
             }
 
             new_items_added = true;
+            mutated = true;
+        }
+
+        // Clones of BF programs already in the next population are wasted assessments
+        if (config->deduplicate)
+        {
+            int changed1 = _deduplicate(config, next1);
+            int changed2 = _deduplicate(config, next2);
+
+            if ((0 > changed1) || (0 > changed2))
+            {
+                return -1;
+            }
+
+            new_items_added |= (0 < changed1) || (0 < changed2);
         }
 
         if (new_items_added)
         {
             next1->fitness = _assess_bf_program(next1, _penalize_length || config->always_penalize_length);
             next2->fitness = _assess_bf_program(next2, _penalize_length || config->always_penalize_length);
+
+            _children_assessed += 2u;
+            _children_improved += (next1->fitness < curr1->fitness) + (next2->fitness < curr2->fitness);
+        }
+
+        if (mutated && config->adaptive_mutation)
+        {
+            _credit_mutation(mutation1, curr1->fitness, next1->fitness);
+            _credit_mutation(mutation2, curr2->fitness, next2->fitness);
         }
     }
 
@@ -581,13 +2491,15 @@ static int _evolve(evolution_config_t *config)
         {
             if (randfloat() <= config->mutation)
             {
-                if (_mutate(config, ACTIVE_POP(i)) < 0)
+                if (_mutate(config, ACTIVE_POP(i), NULL) < 0)
                 {
                     return -1;
                 }
             }
         }
 
+        uint32_t copy_start = nextpos;
+
         memcpy(NEXT_POP(nextpos), ACTIVE_POP(copy_index), BF_PROG_SIZE_BYTES * copy_count);
         nextpos += copy_count;
 
@@ -595,12 +2507,30 @@ static int _evolve(evolution_config_t *config)
          * new random BF programs */
         while (nextpos < config->population_size)
         {
-            bf_program_t *prog = NEXT_POP(nextpos++);
-            prog->program_len = bf_rand_syms(prog->text, BF_MIN_PROG_SIZE, config->max_program_size);
-            prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+            _random_bf_program(config, NEXT_POP(nextpos++));
+        }
+
+        for (uint32_t i = copy_start; config->deduplicate && (i < nextpos); i++)
+        {
+            bf_program_t *prog = NEXT_POP(i);
+            int changed = _deduplicate(config, prog);
+
+            if (0 > changed)
+            {
+                return -1;
+            }
+
+            if (0 < changed)
+            {
+                prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+            }
         }
     }
 
+    // BF programs assessed outside of _evolve are always assessed fully
+    _abort_fitness = UINT32_MAX;
+    _subset_size = 0u;
+
     return 0;
 }
 
@@ -630,28 +2560,116 @@ int evolve_bf_program(evolution_testcase_t *testcases, unsigned int num_testcase
         return -1;
     }
 
+    uint64_t start_ms = ms_since_epoch();
+
+    // Reset all evolution state, in case this is not the first call
+    _stopped = false;
+    _active_pop_index = 0u;
+    _generation = 0u;
+    _penalize_length = false;
+    _num_assessed = 0u;
+    _num_invalid = 0u;
+    _num_timeouts = 0u;
+    _num_dedup_checked = 0u;
+    _num_duplicates = 0u;
+    _total_dedup_checked = 0u;
+    _total_duplicates = 0u;
+    _telemetry_fp = NULL;
+
+    for (uint32_t m = 0u; m < NUM_MUTATIONS; m++)
+    {
+        _mutation_trials[m] = 0.0f;
+        _mutation_successes[m] = 0.0f;
+    }
+
+    output->first_solution_ms = EVOLUTION_NO_TIME;
+    output->final_program_ms = EVOLUTION_NO_TIME;
+
     _testcases = testcases;
     _num_testcases = num_testcases;
+    _start_state = config->start_state;
+
+    checkpoint_header_t resume_header;
+    if (NULL != config->resume_path)
+    {
+        if (checkpoint_read_header(config->resume_path, &resume_header) < 0)
+        {
+            return -1;
+        }
+
+        if (resume_header.testcase_fingerprint != _testcase_fingerprint())
+        {
+            bfi_log("Test cases do not match the test cases in %s", config->resume_path);
+            return -1;
+        }
+
+        // Config is restored from the checkpoint (+1 to account for null terminator)
+        config->max_program_size = resume_header.max_program_size + 1u;
+        config->elitism = resume_header.elitism;
+        config->crossover = resume_header.crossover;
+        config->mutation = resume_header.mutation;
+        config->population_size = resume_header.population_size;
+        config->num_optimization_gens = resume_header.num_optimization_gens;
+        config->always_penalize_length = resume_header.always_penalize_length;
+    }
+
     _elite_border = (unsigned int) (((float) config->population_size) * config->elitism);
 
     // Account for null terminator
     config->max_program_size -= 1u;
 
+    _errors_offset = 0u;
+    _errors_size = 0u;
+    _lexicase_capacity = 0u;
+
+    if (SELECTION_TOURNAMENT != config->selection)
+    {
+        // Keep each BF program 8-byte aligned
+        _errors_offset = ALIGN_UP(BF_PROG_TEXT_BYTES, sizeof(uint64_t));
+        _errors_size = (_errors_offset - BF_PROG_TEXT_BYTES) +
+                       ALIGN_UP(num_testcases * sizeof(uint32_t), sizeof(uint64_t));
+    }
+
     size_t alloc_size = ((config->population_size * BF_PROG_SIZE_BYTES) * 2u) + BF_PROG_SIZE_BYTES;
 
-    char sizebuf[64];
-    hrsize(alloc_size, sizebuf, sizeof(sizebuf));
-    bfi_log("%s allocated", sizebuf);
+    if ((NULL != config->resume_path) &&
+        ((resume_header.prog_size_bytes != BF_PROG_SIZE_BYTES) || (resume_header.data_size != alloc_size)))
+    {
+        bfi_log("%s was written by an incompatible build", config->resume_path);
+        return -1;
+    }
+
+    if (!config->quiet)
+    {
+        char sizebuf[64];
+        hrsize(alloc_size, sizebuf, sizeof(sizebuf));
+        bfi_log("%s allocated", sizebuf);
 
-    bfi_log("elitism=%.2f, crossover=%.2f, mutation=%.2f",
-            config->elitism, config->crossover, config->mutation);
-    bfi_log("population_size=%u, max_program_size=%u, optimization_generations=%d",
-            config->population_size, config->max_program_size,
-            config->num_optimization_gens);
+        bfi_log("elitism=%.2f, crossover=%.2f, mutation=%.2f",
+                config->elitism, config->crossover, config->mutation);
+        bfi_log("population_size=%u, max_program_size=%u, optimization_generations=%d",
+                config->population_size, config->max_program_size,
+                config->num_optimization_gens);
 
-    fflush(stdout);
+        fflush(stdout);
+    }
+
+    _max_output_size = 0u;
+    for (unsigned int i = 0u; i < num_testcases; i++)
+    {
+        _max_output_size = MAX_VAL(_max_output_size, testcases[i].output_size);
+    }
 
-    _population = malloc(alloc_size);
+    /* Buffers for assessing and mutating BF programs go after the populations,
+     * not part of checkpoints */
+    _fitness_buffer_size = fitness_buffer_size(config->fitness, _max_output_size);
+    _max_code = config->max_program_size + 1u;
+    _max_trace = _max_output_size + MAX_EXTRA_OUTPUT;
+    _scratch_size = (sizeof(uint64_t) - 1u) + _fitness_buffer_size + (_max_code * sizeof(bf_insn_t)) +
+                    ((config->run_length_genome) ? (_max_code * sizeof(bf_run_t)) : 0u) +
+                    ((config->output_credit) ? (_max_trace * sizeof(int)) : 0u) +
+                    _max_output_size + MAX_EXTRA_OUTPUT + 1u;
+    _population = malloc(alloc_size + _scratch_size);
 
     if (NULL == _population)
     {
@@ -659,23 +2677,198 @@ int evolve_bf_program(evolution_testcase_t *testcases, unsigned int num_testcase
         return -1;
     }
 
+    _place_scratch_buffers(config, alloc_size);
+
     // Pre-calculate pointer to best item buffer
     _best_item = (bf_program_t *) (((uint8_t *) _population) + (BF_PROG_SIZE_BYTES * config->population_size * 2));
     _best_item->fitness = 0xffffffffu;
 
-    // Generate initial population of completely random BF programs
-    for (unsigned int i = 0; i < config->population_size; i++)
+    unsigned int optgen_count = 0u;  // Number of optimization generations we've done
+    bool optimizing = false;         // Flag to indicate whether we're in the optimization stage
+
+    if (NULL != config->resume_path)
     {
-        bf_program_t *prog = ACTIVE_POP(i);
-        prog->program_len = bf_rand_syms(prog->text, BF_MIN_PROG_SIZE, config->max_program_size);
-        prog->fitness = _assess_bf_program(prog, _penalize_length || config->always_penalize_length);
+        // Restore population exactly as it was, no need to re-assess anything
+        if (checkpoint_read_data(config->resume_path, &resume_header, _population) < 0)
+        {
+            free(_population);
+            return -1;
+        }
+
+        pcg32_set_state(resume_header.rng_state, resume_header.rng_inc);
+        _active_pop_index = resume_header.active_pop_index;
+        _generation = resume_header.generation;
+        optimizing = resume_header.optimizing;
+        optgen_count = resume_header.optgen_count;
+        _penalize_length = optimizing;
+
+        bfi_log("resumed from %s at gen. #%u (stage %d), fitness %u", config->resume_path,
+                _generation, ((int) optimizing) + 1, _best_item->fitness);
+        fflush(stdout);
     }
+    else if (0u < config->num_seed_programs)
+    {
+        // Start from the seed programs, instead of from scratch
+        if (_seed_population(config) < 0)
+        {
+            free(_population);
+            return -1;
+        }
 
-    _sort_active_population(config);
+        if (NULL != config->baseline_program)
+        {
+            _insert_baseline_program(config);
+        }
 
+        _sort_active_population(config);
 
-    unsigned int optgen_count = 0u;  // Number of optimization generations we've done
-    bool optimizing = false;         // Flag to indicate whether we're in the optimization stage
+        if (!config->quiet)
+        {
+            bfi_log("seeded population from %u program(s), fittest has fitness %u",
+                    config->num_seed_programs, ACTIVE_POP(0)->fitness);
+            fflush(stdout);
+        }
+    }
+    else
+    {
+        // Generate initial population of completely random BF programs
+        for (unsigned int i = 0; i < config->population_size; i++)
+        {
+            _random_bf_program(config, ACTIVE_POP(i));
+        }
+
+        if (NULL != config->baseline_program)
+        {
+            _insert_baseline_program(config);
+        }
+
+        _sort_active_population(config);
+    }
+
+    if (NULL != config->checkpoint_path)
+    {
+        if (checkpoint_writer_start(config->checkpoint_path, alloc_size) < 0)
+        {
+            free(_population);
+            return -1;
+        }
+
+        bfi_log("writing checkpoint to %s every %u generations", config->checkpoint_path,
+                config->checkpoint_interval);
+    }
+
+    if (0 <= config->telemetry_fd)
+    {
+        _telemetry_fp = fdopen(config->telemetry_fd, "w");
+        if (NULL == _telemetry_fp)
+        {
+            bfi_log("Failed to open file descriptor %d for telemetry", config->telemetry_fd);
+            free(_population);
+            return -1;
+        }
+    }
+
+    uint64_t telemetry_start_ns = monotonic_ns();
+    uint32_t telemetry_gens = 0u;
+
+    // Restore the state that isn't part of the config or the population
+    if (NULL != config->resume_path)
+    {
+        _initial_elitism = resume_header.initial_elitism;
+        _initial_crossover = resume_header.initial_crossover;
+        _initial_mutation = resume_header.initial_mutation;
+        _last_improved_gen = resume_header.last_improved_gen;
+        _max_population_size = resume_header.max_population_size;
+        memcpy(_mutation_trials, resume_header.mutation_trials, sizeof(_mutation_trials));
+        memcpy(_mutation_successes, resume_header.mutation_successes, sizeof(_mutation_successes));
+    }
+    else
+    {
+        _initial_elitism = config->elitism;
+        _initial_crossover = config->crossover;
+        _initial_mutation = config->mutation;
+        _last_improved_gen = _generation;
+        _max_population_size = config->population_size * RESTART_MAX_GROWTH;
+    }
+
+    _num_bf_programs = ((uint64_t) config->population_size) * _generation;
+
+    _abort_fitness = UINT32_MAX;
+    _subset_size = 0u;
+
+    // Lexicase selection needs errors for every test case
+    if ((0u < config->testcase_subset_size) && (config->testcase_subset_size < _num_testcases) &&
+        (SELECTION_TOURNAMENT == config->selection))
+    {
+        _subset = malloc(_num_testcases * sizeof(unsigned int));
+        if (NULL == _subset)
+        {
+            bfi_log("Failed to allocate memory");
+            _stopped = true;
+        }
+        else
+        {
+            for (unsigned int i = 0u; i < _num_testcases; i++)
+            {
+                _subset[i] = i;
+            }
+        }
+    }
+
+    if (config->ordered_testcases)
+    {
+        _testcase_runs = calloc(_num_testcases, sizeof(float));
+        _testcase_fails = calloc(_num_testcases, sizeof(float));
+        _testcase_order = malloc(_num_testcases * sizeof(unsigned int));
+
+        if ((NULL == _testcase_runs) || (NULL == _testcase_fails) || (NULL == _testcase_order))
+        {
+            bfi_log("Failed to allocate memory");
+            _stopped = true;
+        }
+        else
+        {
+            for (unsigned int i = 0u; i < _num_testcases; i++)
+            {
+                _testcase_order[i] = i;
+            }
+        }
+    }
+
+    _locked_len = 0u;
+
+    if (config->prefix_lock)
+    {
+        // Scratch BF programs don't need room for per-test-case errors
+        size_t part_size = ALIGN_UP(BF_PROG_TEXT_BYTES, sizeof(uint64_t));
+        size_t locks_size = ALIGN_UP(_num_testcases * sizeof(bf_lock_t), sizeof(uint64_t));
+
+        _locks = malloc(locks_size + (part_size * NUM_LOCK_PARTS) +
+                        (config->max_program_size * sizeof(uint32_t)) +
+                        ((config->max_program_size + 1u) * 3u));
+
+        if (NULL == _locks)
+        {
+            bfi_log("Failed to allocate memory");
+            _stopped = true;
+        }
+        else
+        {
+            uint8_t *scratch = ((uint8_t *) _locks) + locks_size;
+
+            for (unsigned int i = 0u; i < NUM_LOCK_PARTS; i++)
+            {
+                _lock_parts[i] = (bf_program_t *) scratch;
+                scratch += part_size;
+            }
+
+            _lock_cuts = (uint32_t *) scratch;
+            _lock_prefix = (char *) (_lock_cuts + config->max_program_size);
+            _lock_candidate = _lock_prefix + config->max_program_size + 1u;
+            _lock_text = _lock_candidate + config->max_program_size + 1u;
+            _lock_candidate_len = 0u;
+        }
+    }
 
     while (!_stopped)
     {
@@ -694,10 +2887,24 @@ int evolve_bf_program(evolution_testcase_t *testcases, unsigned int num_testcase
         // Sort new population
         _sort_active_population(config);
 
+        if (config->adaptive_rates)
+        {
+            _adapt_rates(config);
+        }
+
+        if (NULL != _subset)
+        {
+            _rescore_elite(config);
+        }
+
+        _num_bf_programs += config->population_size;
+
         // See if we have a new fittest item
         if (ACTIVE_POP(0)->fitness < _best_item->fitness)
         {
             memcpy(_best_item, ACTIVE_POP(0), BF_PROG_SIZE_BYTES);
+            output->final_program_ms = ms_since_epoch() - start_ms;
+            _last_improved_gen = _generation;
 
             if (!config->quiet)
             {
@@ -707,12 +2914,105 @@ int evolve_bf_program(evolution_testcase_t *testcases, unsigned int num_testcase
             }
         }
 
+        else if ((0u < config->stagnation_window) &&
+                 ((_generation - _last_improved_gen) >= config->stagnation_window) &&
+                 (_converged_share(config) >= STAGNATION_CONVERGED_SHARE))
+        {
+            int ret = 0;
+
+            switch (config->stagnation_policy)
+            {
+                case STAGNATION_HYPERMUTATE:
+                    ret = _hypermutate(config);
+                    break;
+
+                case STAGNATION_RESEED:
+                    _reseed(config);
+                    break;
+
+                case STAGNATION_RESTART:
+                    ret = _restart(config, _max_population_size, &alloc_size);
+
+                    // Checkpoint writer needs a bigger snapshot buffer
+                    if ((0 == ret) && (NULL != config->checkpoint_path))
+                    {
+                        checkpoint_writer_stop();
+                        ret = checkpoint_writer_start(config->checkpoint_path, alloc_size);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+
+            if (0 > ret)
+            {
+                break;
+            }
+
+            _sort_active_population(config);
+            _last_improved_gen = _generation;
+
+            if (!config->quiet)
+            {
+                bfi_log("(stage %d) gen. #%u, stagnant for %u generations, population_size=%u",
+                        ((int) optimizing) + 1, _generation, config->stagnation_window,
+                        config->population_size);
+                fflush(stdout);
+            }
+        }
+
         _generation++;
 
 	uint32_t target_fitness = (config->always_penalize_length) ? _best_item->program_len : 0u;
 
+        if ((NULL != _locks) && !optimizing && (target_fitness != _best_item->fitness) &&
+            (0u == (_generation % LOCK_INTERVAL)))
+        {
+            size_t locked_len = _locked_len;
+
+            if (_try_lock(config) < 0)
+            {
+                break;
+            }
+
+            if (!config->quiet && (locked_len != _locked_len))
+            {
+                bfi_log("(stage 1) gen. #%u, locked %zu character prefix, %.*s", _generation,
+                        _locked_len, (int) _locked_len, _lock_prefix);
+                fflush(stdout);
+            }
+        }
+
         if ((target_fitness == _best_item->fitness) && !optimizing)
         {
+            output->first_solution_ms = ms_since_epoch() - start_ms;
+
+            // Minimization and the optimization stage work on whole BF programs
+            _locked_len = 0u;
+
+            if (config->minimize)
+            {
+                size_t original_len = _best_item->program_len;
+
+                if (_minimize(config, _best_item) < 0)
+                {
+                    break;
+                }
+
+                output->final_program_ms = ms_since_epoch() - start_ms;
+
+                // Put the minimized BF program in place of the least fit one
+                memcpy(ACTIVE_POP(config->population_size - 1u), _best_item, BF_PROG_SIZE_BYTES);
+
+                if (!config->quiet)
+                {
+                    bfi_log("minimized from %zu to %zu characters, %s", original_len,
+                            _best_item->program_len, _best_item->text);
+                    fflush(stdout);
+                }
+            }
+
             // If fitness reached 0, check if we need to do any optimzation passes
             if (0 == config->num_optimization_gens)
             {
@@ -720,12 +3020,24 @@ int evolve_bf_program(evolution_testcase_t *testcases, unsigned int num_testcase
             }
             else
             {
-                bfi_log("%s optimizing for length", config->always_penalize_length ? "continue" : "start");
-                fflush(stdout);
+                if (!config->quiet)
+                {
+                    bfi_log("%s optimizing for length", config->always_penalize_length ? "continue" : "start");
+                    fflush(stdout);
+                }
 
                 _penalize_length = true;
                 optimizing = true;
 
+                if (config->adaptive_rates)
+                {
+                    // Optimization stage needs different rates; start adapting again
+                    config->elitism = _initial_elitism;
+                    config->crossover = _initial_crossover;
+                    config->mutation = _initial_mutation;
+                    _elite_border = (unsigned int) (((float) config->population_size) * config->elitism);
+                }
+
                 // Re-assess fitness of all items, now that we are optimizing for length
                 for (unsigned int i = 0; i < config->population_size; i++)
                 {
@@ -753,13 +3065,71 @@ int evolve_bf_program(evolution_testcase_t *testcases, unsigned int num_testcase
                 }
             }
         }
+
+        if ((0u < config->max_generations) && (_generation >= config->max_generations))
+        {
+            _stopped = true;
+        }
+
+        if ((NULL != _telemetry_fp) && (++telemetry_gens >= config->telemetry_interval))
+        {
+            uint64_t now = monotonic_ns();
+            _write_telemetry(config, optimizing, telemetry_gens, now - telemetry_start_ns);
+            telemetry_start_ns = now;
+            telemetry_gens = 0u;
+        }
+
+        if ((NULL != config->checkpoint_path) && !_stopped &&
+            (0u == (_generation % config->checkpoint_interval)))
+        {
+            (void) _checkpoint(config, alloc_size, optimizing, optgen_count, false);
+        }
+    }
+
+    if (NULL != config->checkpoint_path)
+    {
+        // Always write a final checkpoint, so an interrupted run can be resumed
+        if (_checkpoint(config, alloc_size, optimizing, optgen_count, true) == 0)
+        {
+            bfi_log("wrote checkpoint to %s", config->checkpoint_path);
+        }
+
+        checkpoint_writer_stop();
+    }
+
+    if (NULL != _telemetry_fp)
+    {
+        fflush(_telemetry_fp);
+    }
+
+    if (config->deduplicate && !config->quiet)
+    {
+        bfi_log("%.2f%% of new BF programs were duplicates",
+                (((double) _total_duplicates) * 100.0) / ((double) MAX_VAL(_total_dedup_checked, 1u)));
     }
 
     // populate output
-    output->num_bf_programs = config->population_size * _generation;
+    output->num_bf_programs = _num_bf_programs;
+    output->num_generations = _generation;
     (void) memcpy(output->bf_program, _best_item->text, _best_item->program_len + 1u);
 
     free(_population);
+    free(_lexicase_buf);
+    free(_testcase_runs);
+    free(_testcase_fails);
+    free(_testcase_order);
+    free(_subset);
+    free(_locks);
+    free(_fingerprints);
+    _lexicase_buf = NULL;
+    _testcase_runs = NULL;
+    _testcase_fails = NULL;
+    _testcase_order = NULL;
+    _subset = NULL;
+    _locks = NULL;
+    _locked_len = 0u;
+    _fingerprints = NULL;
+    _fingerprints_size = 0u;
 
     return 0;
 }
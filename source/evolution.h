@@ -9,24 +9,29 @@
 #ifndef EVOLUTION_H
 #define EVOLUTION_H
 
-#define MAX_TESTCASE_INPUT_SIZE   (128u)
-#define MAX_TESTCASE_OUTPUT_SIZE  (128u)
-
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "bf_utils.h"
+#include "fitness.h"
+
+// Value of evolution_output_t time fields for events that never happened
+#define EVOLUTION_NO_TIME (UINT64_MAX)
 
 
 /**
- * Holds a single test case for the evolution process
+ * Holds a single test case for the evolution process. Input and output data are
+ * not copied, and must stay valid for as long as the test case is in use.
  */
 typedef struct
 {
-    // Input to pass to BF interpreter
-    char input[MAX_TESTCASE_INPUT_SIZE];
+    // Input to pass to BF interpreter (may be NULL if input_size is 0)
+    const char *input;
     size_t input_size;
 
     // Expected output. If BF interpreter produces this output, the testcase matches.
-    char output[MAX_TESTCASE_OUTPUT_SIZE];
+    const char *output;
     size_t output_size;
 } evolution_testcase_t;
 
@@ -39,11 +44,62 @@ typedef struct
     // Total number of BF programs created & executed
     uint64_t num_bf_programs;
 
+    // Total number of generations
+    uint32_t num_generations;
+
+    // Milliseconds from start of evolution until the first BF program that passes
+    // all test cases was produced, or EVOLUTION_NO_TIME if none was produced
+    uint64_t first_solution_ms;
+
+    // Milliseconds from start of evolution until the final best BF program was
+    // produced, or EVOLUTION_NO_TIME if none was produced
+    uint64_t final_program_ms;
+
     // The final best BF program
     char bf_program[];
 } evolution_output_t;
 
 
+/**
+ * Enumerates possible responses to evolution stagnating
+ */
+typedef enum
+{
+    /* Apply several mutations to every BF program except the fittest one */
+    STAGNATION_HYPERMUTATE = 0,
+
+    /* Replace the least fit half of the population with new random BF programs */
+    STAGNATION_RESEED,
+
+    /* Keep only the fittest BF programs, and start again with a larger population
+     * of new random BF programs */
+    STAGNATION_RESTART,
+
+    NUM_STAGNATION_POLICIES
+} stagnation_policy_e;
+
+
+/**
+ * Enumerates methods for selecting the second parent of each new pair of BF programs
+ */
+typedef enum
+{
+    /* Fittest of a small group of randomly picked BF programs */
+    SELECTION_TOURNAMENT = 0,
+
+    /* Filter the population by each test case in a random order, keeping only the
+     * BF programs with the lowest error on that test case, until one is left */
+    SELECTION_LEXICASE,
+
+    /* Same as SELECTION_LEXICASE, but BF programs within a tolerance of the lowest
+     * error (median absolute deviation of the population's errors on that test
+     * case) are kept as well */
+    SELECTION_EPSILON_LEXICASE,
+
+    NUM_SELECTION_METHODS
+} selection_method_e;
+
+
 /**
  * Holds all configurable options for evolution
  */
@@ -74,13 +130,121 @@ typedef struct
      * which passes all test cases. -1 to continue forever. */
     int num_optimization_gens;
 
+    /* Maximum number of generations to run in total, regardless of whether a BF
+     * program that passes all test cases has been produced. 0 for no limit. */
+    uint32_t max_generations;
+
     /* If true, always penalize longer brainfuck programs, rather than only penalizing
      * for length after all test cases are passing. */
     bool always_penalize_length;
 
+    /* If true, select mutation operators based on how often each one has recently
+     * produced a BF program fitter than its parent, rather than uniformly */
+    bool adaptive_mutation;
+
+    /* If true, mutate BF programs as a list of runs of identical BF symbols, e.g.
+     * "+++++" is a single run of 5 '+' symbols. Mutations add, remove, move and
+     * copy whole runs, and change the number of symbols in a run directly. */
+    bool run_length_genome;
+
+    /* If true, keep the brackets of new BF programs balanced; crossover only joins
+     * slices of BF programs that start/end at the same loop depth, mutations add
+     * '[' and ']' in matching pairs, and any bracket left unmatched by crossover
+     * or mutation is removed */
+    bool preserve_brackets;
+
+    /* If true, record which '.' in each BF program printed the first wrong output
+     * character, and mutate BF programs near that '.' instead of anywhere */
+    bool output_credit;
+
+    /* If true, lock the longest prefix (ending with a '.', outside of any loop) of
+     * the fittest BF program that prints the start of every expected output, once
+     * it has stayed the same for a while. Locked prefixes are run once per test
+     * case, and only the rest of each BF program is evolved and run, until the
+     * first solution is found. */
+    bool prefix_lock;
+
+    /* If true, new BF programs that are identical to another BF program in the
+     * same generation are mutated until they are unique, before being assessed */
+    bool deduplicate;
+
+    /* If true, adjust elitism, crossover and mutation each generation, based on
+     * the observed improvement rate and population diversity. The configured values
+     * are used as starting values, and again at the start of the optimization stage. */
+    bool adaptive_rates;
+
+    /* How to select the second parent of each new pair of BF programs. Lexicase
+     * methods keep an error value per test case for each BF program. */
+    selection_method_e selection;
+
+    /* How to compute the error of the output of a BF program on a single test case */
+    fitness_metric_e fitness;
+
+    /* If true, run the test cases that have recently failed most often first, and
+     * stop assessing a new BF program as soon as its fitness is too low for the
+     * elite, rather than always running all test cases in the order provided */
+    bool ordered_testcases;
+
+    /* Number of randomly selected test cases to assess new BF programs on, drawn
+     * again every generation. BF programs are re-assessed on all test cases before
+     * they are selected as elite. 0 to always use all test cases. Ignored for
+     * lexicase selection. */
+    uint32_t testcase_subset_size;
+
+    /* If true, shorten the first BF program that passes all test cases by
+     * removing chunks and single characters for as long as it still passes all
+     * test cases, before optimizing for length by evolution (if at all) */
+    bool minimize;
+
+    /* Number of generations without any improvement in the fittest BF program,
+     * after which evolution is considered stagnant if the population has also
+     * lost its diversity. 0 to disable stagnation detection. */
+    uint32_t stagnation_window;
+
+    /* What to do when evolution is stagnant */
+    stagnation_policy_e stagnation_policy;
+
     /* If false, print status + fittest BF program each time a new fittest BF
      * program is produced. Otherwise, only print the fittest BF program on termination. */
     bool quiet;
+
+    /* BF programs to start evolution from. The initial population is filled with
+     * these, followed by mutated copies of them, instead of random BF programs.
+     * Ignored when resuming from a checkpoint. */
+    const char * const *seed_programs;
+
+    /* Number of BF programs in seed_programs. 0 to start evolution from a
+     * population of random BF programs. */
+    unsigned int num_seed_programs;
+
+    /* BF program that is put in place of the least fit BF program in the initial
+     * population, e.g. a long BF program that is known to pass all test cases.
+     * NULL to disable. Ignored when resuming from a checkpoint. */
+    const char *baseline_program;
+
+    /* Interpreter state that every BF program starts from, instead of an empty tape.
+     * NULL to start from an empty tape. */
+    const bf_state_t *start_state;
+
+    /* Path of file to periodically write a checkpoint of the evolution state to.
+     * NULL to disable checkpoints. */
+    const char *checkpoint_path;
+
+    /* Number of generations between checkpoints */
+    uint32_t checkpoint_interval;
+
+    /* Path of a checkpoint file to resume evolution from. NULL to start evolution
+     * from a new random population. When resuming, population_size,
+     * max_program_size, elitism, crossover, mutation, num_optimization_gens and
+     * always_penalize_length are all taken from the checkpoint file. */
+    const char *resume_path;
+
+    /* File descriptor to write a JSON-lines stream of per-generation statistics
+     * to. -1 to disable. */
+    int telemetry_fd;
+
+    /* Number of generations between records written to telemetry_fd */
+    uint32_t telemetry_interval;
 } evolution_config_t;
 
 
@@ -0,0 +1,336 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include "common.h"
+#include "fitness.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FITNESS_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define FITNESS_X86_SIMD 0
+#endif
+
+
+/* Characters are compared as plain 'char', like the scalar loop always has.
+ * Flipping the top bit of signed chars gives unsigned values with the same
+ * differences, so the unsigned SAD instructions can be used. */
+#define SIGN_BIAS ((CHAR_MIN < 0) ? 0x80 : 0x00)
+
+// Number of expected output characters handled by each word of the edit distance kernel
+#define BLOCK_BITS (64u)
+
+// Number of words in the working buffer of the edit distance kernel, per block
+#define BLOCK_WORDS (UCHAR_MAX + 1u + 2u)
+
+
+typedef uint64_t (*sad_func_t)(const char *, const char *, size_t);
+
+typedef uint32_t (*fitness_func_t)(const char *, size_t, const char *, size_t);
+
+
+static sad_func_t _sad_func = NULL;
+static fitness_func_t _fitness_func = fitness_positional;
+static void *_buffer = NULL;
+
+
+// Sum of absolute differences between characters, one at a time
+static uint64_t _sad_scalar(const char *a, const char *b, size_t size)
+{
+    uint64_t sum = 0u;
+
+    for (size_t i = 0u; i < size; i++)
+    {
+        sum += (uint64_t) abs(a[i] - b[i]);
+    }
+
+    return sum;
+}
+
+#if FITNESS_X86_SIMD
+
+// Sum of absolute differences between characters, 16 at a time
+__attribute__((target("sse2")))
+static uint64_t _sad_sse2(const char *a, const char *b, size_t size)
+{
+    const __m128i bias = _mm_set1_epi8((char) SIGN_BIAS);
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0u;
+
+    for (; (i + 16u) <= size; i += 16u)
+    {
+        __m128i va = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (a + i)), bias);
+        __m128i vb = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (b + i)), bias);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, acc);
+
+    return lanes[0] + lanes[1] + _sad_scalar(a + i, b + i, size - i);
+}
+
+// Sum of absolute differences between characters, 32 at a time
+__attribute__((target("avx2")))
+static uint64_t _sad_avx2(const char *a, const char *b, size_t size)
+{
+    const __m256i bias = _mm256_set1_epi8((char) SIGN_BIAS);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0u;
+
+    for (; (i + 32u) <= size; i += 32u)
+    {
+        __m256i va = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (a + i)), bias);
+        __m256i vb = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (b + i)), bias);
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, acc);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + _sad_scalar(a + i, b + i, size - i);
+}
+
+#endif // FITNESS_X86_SIMD
+
+// Pick the widest SAD kernel that the CPU supports
+static sad_func_t _select_sad(void)
+{
+#if FITNESS_X86_SIMD
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return _sad_avx2;
+    }
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return _sad_sse2;
+    }
+#endif // FITNESS_X86_SIMD
+
+    return _sad_scalar;
+}
+
+// Sum of absolute differences between characters, using the fastest available kernel
+static uint64_t _sad(const char *a, const char *b, size_t size)
+{
+    // Short outputs are not worth setting up vectors for
+    if (size < 16u)
+    {
+        return _sad_scalar(a, b, size);
+    }
+
+    if (NULL == _sad_func)
+    {
+        _sad_func = _select_sad();
+    }
+
+    return _sad_func(a, b, size);
+}
+
+/* Every term of the error is positive, so saturating once at the end gives the
+ * same result as saturating after every addition */
+static uint32_t _saturate(uint64_t error)
+{
+    return (uint32_t) MIN_VAL(error, (uint64_t) UINT32_MAX);
+}
+
+/* Same as fitness_positional, but the difference between characters at index i
+ * is multiplied by the number of expected output characters from index i onwards */
+static uint32_t _prefix_weighted(const char *expected, size_t expected_size, const char *output,
+                                 size_t output_size)
+{
+    size_t smallest_size = MIN_VAL(expected_size, output_size);
+    size_t diff = MAX_VAL(expected_size, output_size) - smallest_size;
+    uint64_t sum = 0u;
+
+    for (size_t i = 0u; i < smallest_size; i++)
+    {
+        sum += ((uint64_t) abs(expected[i] - output[i])) * (expected_size - i);
+    }
+
+    return _saturate((((uint64_t) diff) * FITNESS_LENGTH_PENALTY) + (sum * FITNESS_CHAR_PENALTY));
+}
+
+// Edit distance kernel for the working buffer set by fitness_set_metric
+static uint32_t _levenshtein(const char *expected, size_t expected_size, const char *output,
+                             size_t output_size)
+{
+    return fitness_levenshtein(expected, expected_size, output, output_size, _buffer);
+}
+
+/* Edit distance between 'expected' and 'output', using Myers' bit-parallel
+ * algorithm in the blocked form described by Hyyrö. Each block holds the
+ * vertical deltas of 64 rows of the dynamic programming matrix (one row per
+ * expected output character) as two bit vectors, and one column (one output
+ * character) is computed per step, carrying the horizontal delta of the last
+ * row of each block into the next block. */
+static size_t _edit_distance(const char *expected, size_t expected_size, const char *output,
+                             size_t output_size, uint64_t *buffer)
+{
+    size_t num_blocks = (expected_size + BLOCK_BITS - 1u) / BLOCK_BITS;
+    uint64_t *peq = buffer;
+    uint64_t *pv = buffer + (num_blocks * (UCHAR_MAX + 1u));
+    uint64_t *mv = pv + num_blocks;
+
+    // Bit i of peq[c] is set if expected output character i is c, for each block
+    for (size_t i = 0u; i < expected_size; i++)
+    {
+        uint8_t c = (uint8_t) expected[i];
+        peq[((i / BLOCK_BITS) * (UCHAR_MAX + 1u)) + c] |= 1ull << (i % BLOCK_BITS);
+    }
+
+    for (size_t b = 0u; b < num_blocks; b++)
+    {
+        pv[b] = ~0ull;
+        mv[b] = 0u;
+    }
+
+    // Last row of the last block is the last expected output character
+    uint64_t last_bit = 1ull << ((expected_size - 1u) % BLOCK_BITS);
+    size_t distance = expected_size;
+
+    for (size_t j = 0u; j < output_size; j++)
+    {
+        const uint64_t *col_peq = peq + (uint8_t) output[j];
+
+        // Distance in the top row grows by 1 for every output character
+        int hin = 1;
+
+        for (size_t b = 0u; b < num_blocks; b++)
+        {
+            uint64_t eq = col_peq[b * (UCHAR_MAX + 1u)];
+            uint64_t xv = eq | mv[b];
+            uint64_t hin_neg = (uint64_t) (hin < 0);
+            uint64_t hin_pos = (uint64_t) (hin > 0);
+
+            eq |= hin_neg;
+
+            uint64_t xh = (((eq & pv[b]) + pv[b]) ^ pv[b]) | eq;
+            uint64_t ph = mv[b] | ~(xh | pv[b]);
+            uint64_t mh = pv[b] & xh;
+            uint64_t out_bit = ((b + 1u) == num_blocks) ? last_bit : (1ull << (BLOCK_BITS - 1u));
+
+            hin = ((ph & out_bit) ? 1 : 0) - ((mh & out_bit) ? 1 : 0);
+
+            ph = (ph << 1) | hin_pos;
+            mh = (mh << 1) | hin_neg;
+
+            pv[b] = mh | ~(xv | ph);
+            mv[b] = ph & xv;
+        }
+
+        distance += hin;
+    }
+
+    // Leave the buffer cleared for the next call
+    for (size_t i = 0u; i < expected_size; i++)
+    {
+        uint8_t c = (uint8_t) expected[i];
+        peq[((i / BLOCK_BITS) * (UCHAR_MAX + 1u)) + c] = 0u;
+    }
+
+    return distance;
+}
+
+/**
+ * @see fitness.h
+ */
+uint32_t fitness_positional(const char *expected, size_t expected_size, const char *output,
+                            size_t output_size)
+{
+    size_t smallest_size = MIN_VAL(expected_size, output_size);
+    size_t diff = MAX_VAL(expected_size, output_size) - smallest_size;
+    uint64_t sum = _sad(expected, output, smallest_size);
+
+    return _saturate((((uint64_t) diff) * FITNESS_LENGTH_PENALTY) + (sum * FITNESS_CHAR_PENALTY));
+}
+
+/**
+ * @see fitness.h
+ */
+uint32_t fitness_levenshtein(const char *expected, size_t expected_size, const char *output,
+                             size_t output_size, void *buffer)
+{
+    size_t distance = output_size;
+
+    if (0u < expected_size)
+    {
+        distance = _edit_distance(expected, expected_size, output, output_size, buffer);
+    }
+
+    uint64_t error = ((uint64_t) distance) * FITNESS_LENGTH_PENALTY;
+
+    /* Replacing characters is the only way to fix an output of the right length
+     * without changing its length, so rate replaced characters by how close they
+     * are to the expected ones, like fitness_positional does */
+    if (expected_size == output_size)
+    {
+        uint64_t sum = _sad(expected, output, expected_size);
+        error = MIN_VAL(error, sum * FITNESS_CHAR_PENALTY);
+    }
+
+    return _saturate(error);
+}
+
+/**
+ * @see fitness.h
+ */
+size_t fitness_buffer_size(fitness_metric_e metric, size_t max_expected_size)
+{
+    if (FITNESS_LEVENSHTEIN != metric)
+    {
+        return 0u;
+    }
+
+    size_t num_blocks = (max_expected_size + BLOCK_BITS - 1u) / BLOCK_BITS;
+    return num_blocks * BLOCK_WORDS * sizeof(uint64_t);
+}
+
+/**
+ * @see fitness.h
+ */
+void fitness_set_metric(fitness_metric_e metric, void *buffer, size_t max_expected_size)
+{
+    _buffer = buffer;
+
+    switch (metric)
+    {
+        case FITNESS_PREFIX_WEIGHTED:
+            _fitness_func = _prefix_weighted;
+            break;
+
+        case FITNESS_LEVENSHTEIN:
+            // Peq bit vectors must start out cleared
+            memset(buffer, 0, fitness_buffer_size(metric, max_expected_size));
+            _fitness_func = _levenshtein;
+            break;
+
+        case FITNESS_POSITIONAL:
+        default:
+            _fitness_func = fitness_positional;
+            break;
+    }
+}
+
+/**
+ * @see fitness.h
+ */
+uint32_t fitness_assess(const char *expected, size_t expected_size, const char *output,
+                        size_t output_size)
+{
+    return _fitness_func(expected, expected_size, output, output_size);
+}
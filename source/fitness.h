@@ -0,0 +1,121 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#ifndef FITNESS_H
+#define FITNESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+// Error added for every character too many/too few in the output of a BF program
+#define FITNESS_LENGTH_PENALTY (1000000u)
+
+// Error added for every unit of difference between an output character and the expected character
+#define FITNESS_CHAR_PENALTY   (1000u)
+
+
+/**
+ * Enumerates all available ways to compute the error of the output of a BF program
+ */
+typedef enum
+{
+    /* Penalize every character too many/too few, and the difference between
+     * characters at the same index */
+    FITNESS_POSITIONAL = 0,
+
+    /* Same as FITNESS_POSITIONAL, but differences near the start of the
+     * expected output are penalized more than differences near the end */
+    FITNESS_PREFIX_WEIGHTED,
+
+    /* Penalize the edit distance between the output and the expected output,
+     * so a missing or extra character only costs one edit instead of shifting
+     * every character after it */
+    FITNESS_LEVENSHTEIN,
+
+    NUM_FITNESS_METRICS
+} fitness_metric_e;
+
+
+/**
+ * Compute the error of the output of a BF program against the expected output
+ * of a test case, as FITNESS_LENGTH_PENALTY for every character too many/too few,
+ * plus FITNESS_CHAR_PENALTY times the absolute difference between each output
+ * character and the expected character at the same index. Uses SSE2 or AVX2 if
+ * the CPU supports it.
+ *
+ * @param expected       expected output
+ * @param expected_size  number of characters in expected output
+ * @param output         output of BF program
+ * @param output_size    number of characters in output of BF program
+ *
+ * @return error, saturated at UINT32_MAX. 0 if output matches expected output.
+ */
+uint32_t fitness_positional(const char *expected, size_t expected_size, const char *output,
+                            size_t output_size);
+
+/**
+ * Get the size of the buffer that must be passed to fitness_set_metric
+ *
+ * @param metric             fitness metric to use
+ * @param max_expected_size  max. number of characters in the expected output of any test case
+ *
+ * @return buffer size in bytes, may be 0
+ */
+size_t fitness_buffer_size(fitness_metric_e metric, size_t max_expected_size);
+
+/**
+ * Set the fitness metric used by fitness_assess
+ *
+ * @param metric             fitness metric to use
+ * @param buffer             working buffer for the metric, aligned to 8 bytes, of the
+ *                           size returned by fitness_buffer_size. Must remain valid for
+ *                           as long as fitness_assess is called with this metric.
+ * @param max_expected_size  max. number of characters in the expected output of any test case
+ */
+void fitness_set_metric(fitness_metric_e metric, void *buffer, size_t max_expected_size);
+
+/**
+ * Compute the error of the output of a BF program against the expected output
+ * of a test case, using the metric set by fitness_set_metric. All metrics give
+ * an error of 0 if and only if the output matches the expected output.
+ *
+ * @param expected       expected output
+ * @param expected_size  number of characters in expected output
+ * @param output         output of BF program
+ * @param output_size    number of characters in output of BF program
+ *
+ * @return error, saturated at UINT32_MAX
+ */
+uint32_t fitness_assess(const char *expected, size_t expected_size, const char *output,
+                        size_t output_size);
+
+/**
+ * Compute the error of the output of a BF program against the expected output
+ * of a test case, as FITNESS_LENGTH_PENALTY for every edit (insertion, deletion
+ * or substitution of a character) needed to turn the output into the expected
+ * output. If the output is the right length, and the error computed the same
+ * way as fitness_positional is lower, that error is used instead. The edit
+ * distance is computed with Myers' bit-parallel algorithm, 64 characters of the
+ * expected output at a time.
+ *
+ * @param expected       expected output
+ * @param expected_size  number of characters in expected output
+ * @param output         output of BF program
+ * @param output_size    number of characters in output of BF program
+ * @param buffer         working buffer, aligned to 8 bytes, of the size returned by
+ *                       fitness_buffer_size(FITNESS_LEVENSHTEIN, expected_size).
+ *                       Must be zeroed before the first call, and can then be
+ *                       reused for later calls without clearing it again.
+ *
+ * @return error, saturated at UINT32_MAX. 0 if output matches expected output.
+ */
+uint32_t fitness_levenshtein(const char *expected, size_t expected_size, const char *output,
+                             size_t output_size, void *buffer);
+
+#endif // FITNESS_H
@@ -14,6 +14,12 @@
 
 #include "portable_getopt.h"
 #include "evolution.h"
+#include "checkpoint.h"
+#include "solution_cache.h"
+#include "superopt.h"
+#include "testcase_file.h"
+#include "divide.h"
+#include "bf_utils.h"
 #include "common.h"
 
 #define VERSION                 ("2.3")
@@ -24,12 +30,50 @@
 #define DEFAULT_POPSIZE         (2048)
 #define DEFAULT_MAX_LEN         (4096)
 #define DEFAULT_OPTGENS         (1000)
+#define DEFAULT_CHECKPOINT_GENS (1000)
+#define DEFAULT_TELEMETRY_GENS  (1)
 
 
-#define MAX_NUM_TESTCASES (128u)
+// Test case data loaded from command-line arguments is aligned to this many bytes
+#define CACHE_LINE_SIZE (64u)
 
-static evolution_testcase_t _testcases[MAX_NUM_TESTCASES];
+// Max. number of seed programs loaded by the -i option
+#define MAX_NUM_SEED_PROGRAMS (1024u)
+
+// Characters that are kept when loading seed programs
+#define BF_SYMS "+-<>[].,"
+
+static evolution_testcase_t *_testcases = NULL;
 static unsigned int _num_testcases = 0u;
+static char *_testcase_pool = NULL;
+static const char *_testcase_file_path = NULL;
+static char *_output_buf = NULL;
+
+static const char *_stagnation_policy_names[NUM_STAGNATION_POLICIES] =
+{
+    "hypermutate", "reseed", "restart"
+};
+
+static const char *_selection_method_names[NUM_SELECTION_METHODS] =
+{
+    "tournament", "lexicase", "epsilon-lexicase"
+};
+
+static const char *_fitness_metric_names[NUM_FITNESS_METRICS] =
+{
+    "positional", "prefix", "levenshtein"
+};
+
+static const char *_seed_programs_path = NULL;
+static char *_seed_programs_text = NULL;
+static const char *_seed_programs[MAX_NUM_SEED_PROGRAMS];
+static unsigned int _num_seed_programs = 0u;
+
+static const char *_solution_cache_path = NULL;
+static size_t _segment_size = 0u;
+static size_t _superopt_len = 0u;
+static bool _baseline = false;
+static char *_baseline_program = NULL;
 
 static unsigned int _seed = 0u;
 static bool _seed_provided = false;
@@ -56,7 +100,9 @@ void help_text(char *arg0)
            "to pass.\n\n"
            "A test case may also contain a single ASCII string with no colon. In\n"
            "this case, the provided string will be considered the expected output,\n"
-           "and no input will passed to the Brainfuck program under test.\n\n");
+           "and no input will passed to the Brainfuck program under test.\n\n"
+           "Test cases may also be loaded from a file (see -f option), in which\n"
+           "case no test cases are required on the command line.\n\n");
 
     printf("OPTIONS:\n\n");
     printf("-e <elitism>       Defines how many of the best Brainfuck programs are\n"
@@ -92,6 +138,17 @@ void help_text(char *arg0)
            "                   characters (-1 to optimise infinitely). Default is %d.\n\n",
            DEFAULT_OPTGENS);
 
+    printf("-z                 Once evolution has produced a correct Brainfuck\n"
+           "                   program, shorten it by removing chunks and then\n"
+           "                   single characters, for as long as it still passes\n"
+           "                   all test cases. Happens before the optimization\n"
+           "                   generations set by the -o option; use -o 0 to only\n"
+           "                   shorten the program this way.\n\n");
+
+    printf("-G <num>           Stop evolution after <num> generations in total, even\n"
+           "                   if no Brainfuck program passing all test cases has\n"
+           "                   been produced yet (0 for no limit). Default is 0.\n\n");
+
     printf("-r <seed>          Fixed seed value to seed random number generation.\n"
            "                   The current time (seconds) is used by default.\n\n"),
 
@@ -104,6 +161,192 @@ void help_text(char *arg0)
            "                   entire evolution process (instead of only after all\n"
            "                   test cases are passing, which is default behaviour\n\n");
 
+    printf("-u                 Adaptive mutation; select mutation operators based on\n"
+           "                   how often each one has recently produced a Brainfuck\n"
+           "                   program fitter than the original, rather than\n"
+           "                   selecting all mutation operators equally often.\n\n");
+
+    printf("-g                 Run-length genome; mutate Brainfuck programs as runs\n"
+           "                   of identical symbols (e.g. '+++++' is one run of five\n"
+           "                   '+' symbols) instead of as single characters, so that\n"
+           "                   a mutation can add or remove a few symbols to/from\n"
+           "                   an existing run.\n\n");
+
+    printf("-p                 Preserve brackets; keep '[' and ']' balanced in new\n"
+           "                   Brainfuck programs, by only crossing over Brainfuck\n"
+           "                   programs at the same loop depth, adding brackets in\n"
+           "                   matching pairs, and removing any brackets that are\n"
+           "                   left unmatched. Fewer new Brainfuck programs fail\n"
+           "                   because of unbalanced brackets.\n\n");
+
+    printf("-P                 Output credit assignment; find the '.' symbol that\n"
+           "                   printed the first wrong output character of each\n"
+           "                   Brainfuck program, and mutate the Brainfuck program\n"
+           "                   near that symbol instead of anywhere. Speeds up jobs\n"
+           "                   with long expected outputs.\n\n");
+
+    printf("-L                 Prefix locking; once the fittest Brainfuck program\n"
+           "                   has started with the same code that prints the start\n"
+           "                   of every expected output for a while, lock that code\n"
+           "                   in place, and only evolve (and run) the code after\n"
+           "                   it, until the first solution is found.\n\n");
+
+    printf("-U                 Deduplicate; mutate new Brainfuck programs that are\n"
+           "                   identical to another Brainfuck program in the same\n"
+           "                   generation, until they are unique, instead of\n"
+           "                   assessing the same Brainfuck program twice.\n\n");
+
+    printf("-A                 Adaptive rates; adjust the -e, -c and -m values at\n"
+           "                   each generation, based on how often new Brainfuck\n"
+           "                   programs improve on their parents and on how diverse\n"
+           "                   the population is. The -e, -c and -m values are\n"
+           "                   used as starting values.\n\n");
+
+    printf("-x <method>        How to select the Brainfuck program that each elite\n"
+           "                   Brainfuck program is bred with. 'tournament' picks\n"
+           "                   the fittest of a few random Brainfuck programs.\n"
+           "                   'lexicase' goes through the test cases in a random\n"
+           "                   order, keeping only the Brainfuck programs that do\n"
+           "                   best on each one, which favours programs that solve\n"
+           "                   some test cases perfectly. 'epsilon-lexicase' also\n"
+           "                   keeps Brainfuck programs that are nearly the best on\n"
+           "                   each test case. Default is 'tournament'.\n\n");
+
+    printf("-F <metric>        How to compare the output of a Brainfuck program\n"
+           "                   with the expected output. 'positional' penalizes\n"
+           "                   every character too many/too few, and the difference\n"
+           "                   between characters at the same position. 'prefix'\n"
+           "                   is the same, but penalizes differences near the\n"
+           "                   start more than differences near the end.\n"
+           "                   'levenshtein' penalizes the number of characters\n"
+           "                   that must be inserted, deleted or replaced to get\n"
+           "                   the expected output, so a missing character does\n"
+           "                   not count against every character after it. Output\n"
+           "                   of the right length is scored like 'positional', if\n"
+           "                   that gives a lower error.\n"
+           "                   Default is 'positional'.\n\n");
+
+    printf("-O                 Ordered test cases; run the test cases that have\n"
+           "                   recently failed most often first, and stop running\n"
+           "                   test cases for a new Brainfuck program as soon as it\n"
+           "                   can no longer be selected as 'elite'. Speeds up jobs\n"
+           "                   with many test cases. When -x is not 'tournament',\n"
+           "                   all test cases are always run, since lexicase\n"
+           "                   selection needs results for all test cases.\n\n");
+
+    printf("-S <num>           Test case subsampling; assess each new Brainfuck\n"
+           "                   program on only <num> randomly selected test cases,\n"
+           "                   drawn again at each generation, and re-assess\n"
+           "                   Brainfuck programs on all test cases before they\n"
+           "                   are selected as 'elite'. Speeds up jobs with many\n"
+           "                   test cases. Ignored when -x is not 'tournament'\n"
+           "                   (0 to always use all test cases). Default is 0.\n\n");
+
+    printf("-w <num>           Consider evolution stagnant when the fittest Brainfuck\n"
+           "                   program has not improved for <num> generations, and\n"
+           "                   at least 20%% of the selected 'elite' Brainfuck\n"
+           "                   programs are just as fit as the fittest one (0 to\n"
+           "                   disable). See -W option for what happens when\n"
+           "                   evolution is stagnant. Default is 0.\n\n");
+
+    printf("-W <policy>        What to do when evolution is stagnant (see -w option).\n"
+           "                   'hypermutate' applies several mutations to every\n"
+           "                   Brainfuck program except the fittest one. 'reseed'\n"
+           "                   replaces the least fit half of the population with\n"
+           "                   new random Brainfuck programs. 'restart' keeps only\n"
+           "                   the fittest 2%% of the population, and starts again\n"
+           "                   with a population twice as large (up to 16 times the\n"
+           "                   -s value). Default is 'hypermutate'.\n\n");
+
+    printf("-f <file>          Load test cases from binary test case file <file>,\n"
+           "                   in addition to any test cases given as arguments.\n"
+           "                   The file is memory-mapped and used directly, so\n"
+           "                   large numbers of test cases load quickly, and test\n"
+           "                   cases may contain any bytes, including ':' and NUL.\n"
+           "                   The file starts with the 8 bytes \"%s\" (including\n"
+           "                   the NUL terminator), a 32-bit version (%u) and a\n"
+           "                   32-bit test case count. Each test case follows as a\n"
+           "                   32-bit input size, a 32-bit output size, the input\n"
+           "                   data and the output data. All 32-bit values are in\n"
+           "                   this machine's byte order.\n\n", TESTCASE_FILE_MAGIC,
+           TESTCASE_FILE_VERSION);
+
+    printf("-i <file>          Start evolution from the Brainfuck programs in <file>,\n"
+           "                   instead of from random Brainfuck programs. The initial\n"
+           "                   population is filled with these programs, followed\n"
+           "                   by mutated copies of them. <file> contains one program\n"
+           "                   per line; lines starting with '#' are ignored, as are\n"
+           "                   all characters that are not Brainfuck instructions.\n"
+           "                   Ignored when resuming with -R.\n\n");
+
+    printf("-d <file>          Solution cache; look up the test cases in <file>\n"
+           "                   before starting evolution. If a Brainfuck program\n"
+           "                   for the same set of test cases (in any order) is\n"
+           "                   found, it is shown immediately. Otherwise, the\n"
+           "                   stored Brainfuck programs whose test cases share the\n"
+           "                   longest output prefixes with these test cases are\n"
+           "                   used as seed programs (see -i option). Brainfuck\n"
+           "                   programs passing all test cases are added to <file>\n"
+           "                   when evolution finishes. <file> is created if it\n"
+           "                   does not exist.\n\n");
+
+    printf("-D <num>           Divide and conquer; for test cases with no input,\n"
+           "                   split the expected output into segments of <num>\n"
+           "                   characters, and evolve a Brainfuck program for each\n"
+           "                   segment in turn, starting from where the program for\n"
+           "                   the previous segment left off. The programs are then\n"
+           "                   joined together, and optimized for length as a whole\n"
+           "                   (see -o option). Makes long expected outputs much\n"
+           "                   faster to produce. Can't be used with -k or -R\n"
+           "                   (0 to disable). Default is 0.\n\n");
+
+    printf("-E <num>           Exhaustive search; before starting evolution, try\n"
+           "                   all Brainfuck programs of up to <num> characters\n"
+           "                   (max. %u), shortest first, and skip evolution if\n"
+           "                   one passes all test cases. After evolution, replace\n"
+           "                   each window of up to <num> characters (max. %u)\n"
+           "                   outside of loops in the final Brainfuck program with\n"
+           "                   the shortest sequence that still passes all test\n"
+           "                   cases. Time taken grows very quickly with <num>\n"
+           "                   (0 to disable). Default is 0.\n\n", SUPEROPT_MAX_LEN, SUPEROPT_MAX_WINDOW);
+
+    printf("-B                 For test cases with no input, start evolution from a\n"
+           "                   Brainfuck program that prints the expected output\n"
+           "                   one character at a time, using only '+', '-' and\n"
+           "                   '.', in place of one random program. Evolution then\n"
+           "                   starts optimizing for length (see -o option) right\n"
+           "                   away. Can't be used with -D.\n\n");
+
+    printf("-k <file>          Periodically write a checkpoint of the complete\n"
+           "                   evolution state to <file>, so that evolution can\n"
+           "                   be resumed later with the -R option. A final\n"
+           "                   checkpoint is also written on termination (Ctrl-C).\n\n");
+
+    printf("-K <num>           Number of generations between checkpoints written by\n"
+           "                   the -k option. Default is %d.\n\n", DEFAULT_CHECKPOINT_GENS);
+
+    printf("-R <file>          Resume evolution from a checkpoint file previously\n"
+           "                   written by the -k option. Test cases must be the same\n"
+           "                   as the ones used to write the checkpoint. The -e, -c,\n"
+           "                   -m, -s, -l, -o and -a options are ignored, and the\n"
+           "                   values saved in the checkpoint are used instead.\n"
+           "                   Adapted rates, mutation operator statistics,\n"
+           "                   stagnation counters and the maximum population\n"
+           "                   size are also restored. Per-test case failure\n"
+           "                   statistics (-O) start over, and a prefix locked\n"
+           "                   by the -L option is not saved, so a resumed run\n"
+           "                   starts unlocked.\n\n");
+
+    printf("-t <fd>            Write a stream of evolution statistics to file\n"
+           "                   descriptor <fd>, as one JSON object per line. Each\n"
+           "                   record contains programs per second, best, median\n"
+           "                   and worst fitness, mean program length, the share\n"
+           "                   of invalid and timed-out programs, and mean\n"
+           "                   generation wall time (ms).\n\n");
+
+    printf("-T <num>           Number of generations between records written by\n"
+           "                   the -t option. Default is %d.\n\n", DEFAULT_TELEMETRY_GENS);
+
     printf("-h                 Show this text and exit.\n\n");
 
     printf("EXAMPLES:\n\n");
@@ -118,6 +361,15 @@ void help_text(char *arg0)
     printf("Produce a program that prints \"true\" when input is \"1\", and prints\n"
            "\"false\" when the input is \"0\":\n\n"
            "    %s \"0:false\" \"1:true\"\n\n", arg0);
+
+    printf("Produce a program that prints \"Hello, world!\", writing a checkpoint\n"
+           "every 500 generations, and then resume from that checkpoint later:\n\n"
+           "    %s -k hello.ckpt -K 500 \"Hello, world!\"\n"
+           "    %s -k hello.ckpt -R hello.ckpt \"Hello, world!\"\n\n", arg0, arg0);
+
+    printf("Produce a program that prints \"Hello, world!\", writing statistics\n"
+           "for every 10th generation to stats.jsonl:\n\n"
+           "    %s -t 3 -T 10 \"Hello, world!\" 3>stats.jsonl\n\n", arg0);
 }
 
 // Parse a float from the current 'optarg' string
@@ -159,88 +411,227 @@ static int _parse_int(char optchar, long int *dest)
     return 0;
 }
 
-static int _load_testcase_from_arg(char *arg)
+// Load seed programs for the -i option from a file, one program per line
+static int _load_seed_programs(const char *path)
 {
-    if (MAX_NUM_TESTCASES <= _num_testcases)
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp)
     {
-        bfi_log("Max. test cases exceeded");
+        bfi_log("Failed to open %s for reading", path);
         return -1;
     }
 
-    evolution_testcase_t *testcase = &_testcases[_num_testcases];
+    long int size = -1;
+    if (0 == fseek(fp, 0, SEEK_END))
+    {
+        size = ftell(fp);
+        rewind(fp);
+    }
 
-    // Make 1 pass first to see if testcase string contains input AND output
-    bool has_input = false;
-    for (int i = 0; arg[i]; i++)
+    if (size < 0)
     {
-        if (':' == arg[i])
-        {
-            has_input = true;
-            break;
-        }
+        bfi_log("Failed to read %s", path);
+        fclose(fp);
+        return -1;
     }
 
-    int pos = 0u;
-    if (has_input)
+    _seed_programs_text = malloc(size + 1);
+    if (NULL == _seed_programs_text)
     {
-        // Copy input data to testcase
-        while(':' != arg[pos])
-        {
-            if (MAX_TESTCASE_INPUT_SIZE <= pos)
-            {
-                bfi_log("Max testcase input size (%u) exceeded", MAX_TESTCASE_INPUT_SIZE);
-                return -1;
-            }
+        bfi_log("Failed to allocate %ld bytes", size + 1);
+        fclose(fp);
+        return -1;
+    }
 
-            testcase->input[pos] = arg[pos];
-            pos++;
-        }
+    size_t nread = fread(_seed_programs_text, 1u, (size_t) size, fp);
+    fclose(fp);
 
-        testcase->input_size = pos;
-        testcase->input[testcase->input_size] = 0;
+    _seed_programs_text[nread] = 0;
 
-        // Skip past colon
-        pos++;
-        int output_skip = pos;
+    char *line = _seed_programs_text;
+    while (NULL != line)
+    {
+        char *next = strchr(line, '\n');
+        if (NULL != next)
+        {
+            *next++ = 0;
+        }
 
-        // Copy output data to testcase
-        while(arg[pos])
+        if ('#' != line[0])
         {
-            if (MAX_TESTCASE_OUTPUT_SIZE <= (pos - output_skip))
+            // Keep only BF instructions, in place
+            size_t len = 0u;
+            for (char *c = line; *c; c++)
             {
-                bfi_log("Max testcase output size (%u) exceeded", MAX_TESTCASE_OUTPUT_SIZE);
-                return -1;
+                if (NULL != strchr(BF_SYMS, *c))
+                {
+                    line[len++] = *c;
+                }
             }
 
-            testcase->output[pos - output_skip] = arg[pos];
-            pos++;
+            line[len] = 0;
+
+            if (0u < len)
+            {
+                if (MAX_NUM_SEED_PROGRAMS <= _num_seed_programs)
+                {
+                    bfi_log("Max. seed programs (%u) exceeded", MAX_NUM_SEED_PROGRAMS);
+                    return -1;
+                }
+
+                _seed_programs[_num_seed_programs++] = line;
+            }
         }
 
-        testcase->output_size = pos - output_skip;
-        testcase->output[testcase->output_size] = 0;
+        line = next;
     }
-    else
+
+    if (0u == _num_seed_programs)
+    {
+        bfi_log("No Brainfuck programs found in %s", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Returns true if all test cases expect the same output with no input
+static bool _output_only_testcases(void)
+{
+    for (unsigned int i = 0u; i < _num_testcases; i++)
     {
-        // Testcase only has output data
-        testcase->input_size = 0;
+        if ((0u != _testcases[i].input_size) ||
+            (_testcases[i].output_size != _testcases[0].output_size) ||
+            (0 != memcmp(_testcases[i].output, _testcases[0].output, _testcases[0].output_size)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if a BF program passes a single test case
+static bool _passes_testcase(const char *program, unsigned int i)
+{
+    int len = bf_interpret((char *) program, _testcases[i].input, _testcases[i].input_size,
+                           _output_buf, _testcases[i].output_size, MAX_INSTRUCTIONS_EXEC);
 
-        while(arg[pos])
+    return (0 <= len) && (((size_t) len) == _testcases[i].output_size) &&
+           (0 == memcmp(_output_buf, _testcases[i].output, len));
+}
+
+// Returns true if a BF program passes all test cases
+static bool _passes_all_testcases(const char *program)
+{
+    for (unsigned int i = 0u; i < _num_testcases; i++)
+    {
+        if (!_passes_testcase(program, i))
         {
-            if (MAX_TESTCASE_OUTPUT_SIZE <= pos)
-            {
-                bfi_log("Max testcase output size (%u) exceeded", MAX_TESTCASE_OUTPUT_SIZE);
-                return -1;
-            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void _print_summary(uint64_t ms_elapsed, uint64_t num_bf_programs, unsigned int seedval,
+                           const char *program)
+{
+    double seconds_elapsed = (((double) ms_elapsed) / 1000.0);
+    uint64_t ex_per_sec = (num_bf_programs / MAX_VAL(ms_elapsed, 1u)) * 1000u;
+
+    printf("\n\nTotal runtime                      : %.2f seconds\n", seconds_elapsed);
+    // Print seed again, so it's easy to grab after evolution has finished
+
+    char countbuf[32];
+    hrcount(num_bf_programs, countbuf, sizeof(countbuf));
+    char ratebuf[32];
+    hrcount(ex_per_sec, ratebuf, sizeof(ratebuf));
+
+    printf("Total BF programs created/executed : %s (%s per second)\n", countbuf, ratebuf);
+    printf("random seed                        : %u\n", seedval);
+    printf("Best BF program                    : %s\n\n", program);
+}
+
+/* Load test cases from the test case file (if any), followed by test cases
+ * from command-line arguments. Test cases from the file point directly into the
+ * mapped file. Input and output data of test cases from command-line arguments
+ * is copied into a single pool, with each test case starting on a new cache line. */
+static int _load_testcases(char *args[], unsigned int num_args)
+{
+    unsigned int num_file_testcases = 0u;
+    size_t pool_size = 0u;
+    size_t max_output_size = 0u;
 
-            testcase->output[pos] = arg[pos];
-            pos++;
+    if (NULL != _testcase_file_path)
+    {
+        int ret = testcase_file_open(_testcase_file_path);
+        if (ret < 0)
+        {
+            return -1;
         }
 
-        testcase->output_size = pos;
-        testcase->output[testcase->output_size] = 0;
+        num_file_testcases = (unsigned int) ret;
+    }
+
+    for (unsigned int i = 0u; i < num_args; i++)
+    {
+        pool_size += ALIGN_UP(strlen(args[i]), CACHE_LINE_SIZE);
+    }
+
+    _testcases = malloc((num_file_testcases + num_args) * sizeof(evolution_testcase_t));
+    _testcase_pool = malloc(pool_size + CACHE_LINE_SIZE);
+
+    if ((NULL == _testcases) || (NULL == _testcase_pool))
+    {
+        bfi_log("Failed to allocate memory");
+        return -1;
+    }
+
+    if (0u < num_file_testcases)
+    {
+        testcase_file_read(_testcases);
+    }
+
+    for (unsigned int i = 0u; i < num_file_testcases; i++)
+    {
+        max_output_size = MAX_VAL(max_output_size, _testcases[i].output_size);
+    }
+
+    char *data = (char *) ALIGN_UP((uintptr_t) _testcase_pool, CACHE_LINE_SIZE);
+
+    for (unsigned int i = 0u; i < num_args; i++)
+    {
+        evolution_testcase_t *testcase = &_testcases[num_file_testcases + i];
+        const char *arg = args[i];
+        const char *colon = strchr(arg, ':');
+        size_t len = strlen(arg);
+
+        // Input data comes before the first colon, if there is one
+        testcase->input_size = (NULL == colon) ? 0u : (size_t) (colon - arg);
+        testcase->output_size = (NULL == colon) ? len : (len - testcase->input_size - 1u);
+
+        testcase->input = data;
+        testcase->output = data + testcase->input_size;
+
+        memcpy(data, arg, testcase->input_size);
+        memcpy(data + testcase->input_size, arg + (len - testcase->output_size), testcase->output_size);
+
+        max_output_size = MAX_VAL(max_output_size, testcase->output_size);
+        data += ALIGN_UP(len, CACHE_LINE_SIZE);
+    }
+
+    _num_testcases = num_file_testcases + num_args;
+
+    // Buffer for checking the output of BF programs against the longest expected output
+    _output_buf = malloc(max_output_size + 1u);
+    if (NULL == _output_buf)
+    {
+        bfi_log("Failed to allocate memory");
+        return -1;
     }
 
-    _num_testcases++;
     return 0;
 }
 
@@ -249,7 +640,7 @@ static int _parse_args(evolution_config_t *cfg, int argc, char *argv[])
 {
     char c;
 
-    while ((c = portable_getopt(argc, argv, "hqae:c:m:s:o:l:r:")) != -1)
+    while ((c = portable_getopt(argc, argv, "hqauAgpPLUOzBf:e:i:d:D:E:c:m:s:o:l:r:k:K:R:t:T:G:w:W:x:S:F:")) != -1)
     {
         switch (c)
         {
@@ -332,6 +723,24 @@ static int _parse_args(evolution_config_t *cfg, int argc, char *argv[])
                 break;
             }
 
+            case 'G':
+            {
+                long int max_gens = 0;
+                if (_parse_int('G', &max_gens) < 0)
+                {
+                    return -1;
+                }
+
+                if (max_gens < 0)
+                {
+                    bfi_log("Invalid value provided for -G option, must be 0 or greater\n");
+                    return -1;
+                }
+
+                cfg->max_generations = (uint32_t) max_gens;
+                break;
+            }
+
             case 'r':
             {
                 long int lseed = 0;
@@ -351,10 +760,257 @@ static int _parse_args(evolution_config_t *cfg, int argc, char *argv[])
                 break;
             }
 
+            case 'w':
+            {
+                long int window = 0;
+                if (_parse_int('w', &window) < 0)
+                {
+                    return -1;
+                }
+
+                if (window < 0)
+                {
+                    bfi_log("Invalid value provided for -w option, must be 0 or greater\n");
+                    return -1;
+                }
+
+                cfg->stagnation_window = (uint32_t) window;
+                break;
+            }
+
+            case 'W':
+            {
+                int i;
+                for (i = 0; i < NUM_STAGNATION_POLICIES; i++)
+                {
+                    if (0 == strcmp(optarg, _stagnation_policy_names[i]))
+                    {
+                        cfg->stagnation_policy = (stagnation_policy_e) i;
+                        break;
+                    }
+                }
+
+                if (NUM_STAGNATION_POLICIES == i)
+                {
+                    bfi_log("Invalid value provided for -W option, must be one of: hypermutate, reseed, restart\n");
+                    return -1;
+                }
+                break;
+            }
+
+            case 'x':
+            {
+                int i;
+                for (i = 0; i < NUM_SELECTION_METHODS; i++)
+                {
+                    if (0 == strcmp(optarg, _selection_method_names[i]))
+                    {
+                        cfg->selection = (selection_method_e) i;
+                        break;
+                    }
+                }
+
+                if (NUM_SELECTION_METHODS == i)
+                {
+                    bfi_log("Invalid value provided for -x option, must be one of: tournament, lexicase, epsilon-lexicase\n");
+                    return -1;
+                }
+                break;
+            }
+
+            case 'F':
+            {
+                int i;
+                for (i = 0; i < NUM_FITNESS_METRICS; i++)
+                {
+                    if (0 == strcmp(optarg, _fitness_metric_names[i]))
+                    {
+                        cfg->fitness = (fitness_metric_e) i;
+                        break;
+                    }
+                }
+
+                if (NUM_FITNESS_METRICS == i)
+                {
+                    bfi_log("Invalid value provided for -F option, must be one of: positional, prefix, levenshtein\n");
+                    return -1;
+                }
+                break;
+            }
+
+            case 'S':
+            {
+                long int subset_size = 0;
+                if (_parse_int('S', &subset_size) < 0)
+                {
+                    return -1;
+                }
+
+                if (subset_size < 0)
+                {
+                    bfi_log("Invalid value provided for -S option, must be 0 or greater\n");
+                    return -1;
+                }
+
+                cfg->testcase_subset_size = (uint32_t) subset_size;
+                break;
+            }
+
+            case 'i':
+                _seed_programs_path = optarg;
+                break;
+
+            case 'd':
+                _solution_cache_path = optarg;
+                break;
+
+            case 'D':
+            {
+                long int segment_size = 0;
+                if (_parse_int('D', &segment_size) < 0)
+                {
+                    return -1;
+                }
+
+                if (segment_size < 0)
+                {
+                    bfi_log("Invalid value provided for -D option, must be 0 or greater\n");
+                    return -1;
+                }
+
+                _segment_size = (size_t) segment_size;
+                break;
+            }
+
+            case 'E':
+            {
+                long int superopt_len = 0;
+                if (_parse_int('E', &superopt_len) < 0)
+                {
+                    return -1;
+                }
+
+                if ((superopt_len < 0) || (superopt_len > SUPEROPT_MAX_LEN))
+                {
+                    bfi_log("Invalid value provided for -E option, must be between 0 and %u\n",
+                            SUPEROPT_MAX_LEN);
+                    return -1;
+                }
+
+                _superopt_len = (size_t) superopt_len;
+                break;
+            }
+
+            case 'k':
+                cfg->checkpoint_path = optarg;
+                break;
+
+            case 'K':
+            {
+                long int ckpt_gens = 0;
+                if (_parse_int('K', &ckpt_gens) < 0)
+                {
+                    return -1;
+                }
+
+                if (ckpt_gens <= 0)
+                {
+                    bfi_log("Invalid value provided for -K option, must be 1 or greater\n");
+                    return -1;
+                }
+
+                cfg->checkpoint_interval = (uint32_t) ckpt_gens;
+                break;
+            }
+
+            case 'R':
+                cfg->resume_path = optarg;
+                break;
+
+            case 't':
+            {
+                long int fd = 0;
+                if (_parse_int('t', &fd) < 0)
+                {
+                    return -1;
+                }
+
+                if (fd < 0)
+                {
+                    bfi_log("Invalid value provided for -t option, must be 0 or greater\n");
+                    return -1;
+                }
+
+                cfg->telemetry_fd = (int) fd;
+                break;
+            }
+
+            case 'T':
+            {
+                long int telemetry_gens = 0;
+                if (_parse_int('T', &telemetry_gens) < 0)
+                {
+                    return -1;
+                }
+
+                if (telemetry_gens <= 0)
+                {
+                    bfi_log("Invalid value provided for -T option, must be 1 or greater\n");
+                    return -1;
+                }
+
+                cfg->telemetry_interval = (uint32_t) telemetry_gens;
+                break;
+            }
+
             case 'a':
                 cfg->always_penalize_length = true;
                 break;
 
+            case 'u':
+                cfg->adaptive_mutation = true;
+                break;
+
+            case 'A':
+                cfg->adaptive_rates = true;
+                break;
+
+            case 'g':
+                cfg->run_length_genome = true;
+                break;
+
+            case 'p':
+                cfg->preserve_brackets = true;
+                break;
+
+            case 'P':
+                cfg->output_credit = true;
+                break;
+
+            case 'L':
+                cfg->prefix_lock = true;
+                break;
+
+            case 'U':
+                cfg->deduplicate = true;
+                break;
+
+            case 'O':
+                cfg->ordered_testcases = true;
+                break;
+
+            case 'z':
+                cfg->minimize = true;
+                break;
+
+            case 'B':
+                _baseline = true;
+                break;
+
+            case 'f':
+                _testcase_file_path = optarg;
+                break;
+
             case 'q':
                 cfg->quiet = true;
                 break;
@@ -366,43 +1022,187 @@ static int _parse_args(evolution_config_t *cfg, int argc, char *argv[])
         }
     }
 
-    if (argv[optind] == NULL)
+    if ((argv[optind] == NULL) && (NULL == _testcase_file_path))
     {
         help_text(argv[0]);
         return -1;
     }
 
-    while (argv[optind] != NULL)
-    {
-        if (_load_testcase_from_arg(argv[optind]) < 0)
-        {
-            return -1;
-        }
-
-        optind++;
-    }
-
-    return 0;
+    return _load_testcases(&argv[optind], (unsigned int) (argc - optind));
 }
 
 int main(int argc, char *argv[])
 {
     time_t t;
 
-    evolution_config_t config = {DEFAULT_ELITISM, DEFAULT_CROSSOVER, DEFAULT_MUTATION,
-                                 DEFAULT_POPSIZE, DEFAULT_MAX_LEN, DEFAULT_OPTGENS, false, false};
+    evolution_config_t config =
+    {
+        .elitism = DEFAULT_ELITISM,
+        .crossover = DEFAULT_CROSSOVER,
+        .mutation = DEFAULT_MUTATION,
+        .population_size = DEFAULT_POPSIZE,
+        .max_program_size = DEFAULT_MAX_LEN,
+        .num_optimization_gens = DEFAULT_OPTGENS,
+        .selection = SELECTION_TOURNAMENT,
+        .fitness = FITNESS_POSITIONAL,
+        .stagnation_policy = STAGNATION_HYPERMUTATE,
+        .checkpoint_interval = DEFAULT_CHECKPOINT_GENS,
+        .telemetry_fd = -1,
+        .telemetry_interval = DEFAULT_TELEMETRY_GENS,
+    };
 
     if (_parse_args(&config, argc, argv) < 0)
     {
         return -1;
     }
 
+    if (0u < _segment_size)
+    {
+        if ((NULL != config.checkpoint_path) || (NULL != config.resume_path))
+        {
+            bfi_log("-D option can't be used with -k or -R options");
+            return -1;
+        }
+
+        if (!_output_only_testcases())
+        {
+            bfi_log("-D option can only be used with test cases that have no input");
+            return -1;
+        }
+    }
+
+    if (_baseline)
+    {
+        if (0u < _segment_size)
+        {
+            bfi_log("-B option can't be used with -D option");
+            return -1;
+        }
+
+        if (!_output_only_testcases())
+        {
+            bfi_log("-B option can only be used with test cases that have no input");
+            return -1;
+        }
+    }
+
+    if (NULL != config.resume_path)
+    {
+        // Need max. program size from the checkpoint, to allocate enough space for output
+        checkpoint_header_t header;
+        if (checkpoint_read_header(config.resume_path, &header) < 0)
+        {
+            return -1;
+        }
+
+        config.max_program_size = header.max_program_size + 1u;
+    }
+
     bfi_log("successfully loaded %u test case(s)", _num_testcases);
 
     unsigned int seedval = (_seed_provided) ? _seed : (unsigned int) time(&t);
     pcg32_seed(seedval);
     bfi_log("random seed: %u", seedval);
 
+    if (NULL != _seed_programs_path)
+    {
+        if (_load_seed_programs(_seed_programs_path) < 0)
+        {
+            return -1;
+        }
+
+        bfi_log("successfully loaded %u seed program(s)", _num_seed_programs);
+    }
+
+    if (NULL != _solution_cache_path)
+    {
+        uint64_t lookup_start = ms_since_epoch();
+
+        if (solution_cache_open(_solution_cache_path) < 0)
+        {
+            return -1;
+        }
+
+        const char *cached = solution_cache_find(_testcases, _num_testcases);
+        if ((NULL != cached) && _passes_all_testcases(cached))
+        {
+            bfi_log("found solution in %s", _solution_cache_path);
+            _print_summary(ms_since_epoch() - lookup_start, 0u, seedval, cached);
+            solution_cache_close();
+            free(_seed_programs_text);
+            return 0;
+        }
+
+        unsigned int num_nearest = solution_cache_nearest(_testcases, _num_testcases,
+                                                          &_seed_programs[_num_seed_programs],
+                                                          MAX_NUM_SEED_PROGRAMS - _num_seed_programs);
+        if (0u < num_nearest)
+        {
+            bfi_log("seeding from %u similar solution(s) in %s", num_nearest, _solution_cache_path);
+            _num_seed_programs += num_nearest;
+        }
+    }
+
+    if (0u < _superopt_len)
+    {
+        uint64_t search_start = ms_since_epoch();
+        uint64_t num_searched = 0u;
+        char program[SUPEROPT_MAX_LEN + 1u];
+
+        int len = superopt_search(_testcases, _num_testcases, _superopt_len, program, &num_searched);
+        if (len < 0)
+        {
+            return -1;
+        }
+
+        if (0 < len)
+        {
+            bfi_log("found solution by exhaustive search");
+            _print_summary(ms_since_epoch() - search_start, num_searched, seedval, program);
+            solution_cache_close();
+
+            if ((NULL != _solution_cache_path) &&
+                (solution_cache_store(_solution_cache_path, _testcases, _num_testcases, program) == 0))
+            {
+                bfi_log("added solution to %s", _solution_cache_path);
+            }
+
+            free(_seed_programs_text);
+            return 0;
+        }
+
+        bfi_log("no Brainfuck program of up to %zu characters found", _superopt_len);
+    }
+
+    if (_baseline)
+    {
+        _baseline_program = malloc(config.max_program_size + 1u);
+        if (NULL == _baseline_program)
+        {
+            bfi_log("Failed to allocate memory");
+            return -1;
+        }
+
+        int len = bf_print_program(_testcases[0].output, _testcases[0].output_size,
+                                   _baseline_program, config.max_program_size);
+        if (len < 0)
+        {
+            bfi_log("constructed Brainfuck program is longer than max. program size, not using it");
+        }
+        else if (!_passes_testcase(_baseline_program, 0u))
+        {
+            bfi_log("constructed Brainfuck program does not print the expected output, not using it");
+        }
+        else
+        {
+            bfi_log("starting from constructed Brainfuck program of %d characters", len);
+            config.baseline_program = _baseline_program;
+        }
+    }
+
+    config.seed_programs = _seed_programs;
+    config.num_seed_programs = _num_seed_programs;
+
     // allocate space for output
     size_t output_size = sizeof(evolution_output_t) + config.max_program_size + 1;
     evolution_output_t *output = malloc(output_size);
@@ -415,27 +1215,56 @@ int main(int argc, char *argv[])
     uint64_t start_time = ms_since_epoch();
 
     // Runs until a BF program with fitness of 0 (best fitness) is produced, or until Ctrl-C
-    int ret = evolve_bf_program(_testcases, _num_testcases, &config, output);
+    int ret;
+
+    if ((0u < _segment_size) && (_testcases[0].output_size > _segment_size))
+    {
+        ret = divide_and_conquer(&_testcases[0], _segment_size, &config, output);
+    }
+    else
+    {
+        ret = evolve_bf_program(_testcases, _num_testcases, &config, output);
+    }
+
+    // Seed programs may point into the mapped solution cache
+    solution_cache_close();
+
     if (0 != ret)
     {
         return ret;
     }
 
-    uint64_t ms_elapsed = ms_since_epoch() - start_time;
-    double seconds_elapsed = (((double) ms_elapsed) / 1000.0);
-    uint64_t ex_per_sec = (output->num_bf_programs / ms_elapsed) * 1000u;
+    if ((0u < _superopt_len) && _passes_all_testcases(output->bf_program))
+    {
+        size_t original_len = strlen(output->bf_program);
+        int len = superopt_polish(_testcases, _num_testcases,
+                                  MAX_VAL(MIN_VAL(_superopt_len, SUPEROPT_MAX_WINDOW), 2u),
+                                  output->bf_program, &output->num_bf_programs);
 
-    printf("\n\nTotal runtime                      : %.2f seconds\n", seconds_elapsed);
-    // Print seed again, so it's easy to grab after evolution has finished
+        if ((0 <= len) && (((size_t) len) < original_len))
+        {
+            bfi_log("replaced windows of up to %zu characters, from %zu to %d characters",
+                    MIN_VAL(_superopt_len, SUPEROPT_MAX_WINDOW), original_len, len);
+        }
+    }
 
-    char countbuf[32];
-    hrcount(output->num_bf_programs, countbuf, sizeof(countbuf));
-    char ratebuf[32];
-    hrcount(ex_per_sec, ratebuf, sizeof(ratebuf));
+    uint64_t ms_elapsed = ms_since_epoch() - start_time;
+    _print_summary(ms_elapsed, output->num_bf_programs, seedval, output->bf_program);
 
-    printf("Total BF programs created/executed : %s (%s per second)\n", countbuf, ratebuf);
-    printf("random seed                        : %u\n", seedval);
-    printf("Best BF program                    : %s\n\n", output->bf_program);
+    if ((NULL != _solution_cache_path) && _passes_all_testcases(output->bf_program))
+    {
+        if (solution_cache_store(_solution_cache_path, _testcases, _num_testcases,
+                                 output->bf_program) == 0)
+        {
+            bfi_log("added solution to %s", _solution_cache_path);
+        }
+    }
 
     free(output);
+    free(_seed_programs_text);
+    free(_baseline_program);
+    free(_testcases);
+    free(_testcase_pool);
+    free(_output_buf);
+    testcase_file_close();
 }
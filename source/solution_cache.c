@@ -0,0 +1,429 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "common.h"
+#include "solution_cache.h"
+
+
+#define RECORD_ALIGN (8u)
+
+
+/**
+ * Points to a single test case stored in a solution record
+ */
+typedef struct
+{
+    const uint8_t *input;
+    uint32_t input_size;
+    const uint8_t *output;
+    uint32_t output_size;
+} stored_testcase_t;
+
+
+static const uint8_t *_data = NULL;
+static size_t _size = 0u;
+
+
+// qsort compare function to put test cases in normalized order
+static int _cmptestcases(const void *a, const void *b)
+{
+    const evolution_testcase_t *ta = *((const evolution_testcase_t * const *) a);
+    const evolution_testcase_t *tb = *((const evolution_testcase_t * const *) b);
+
+    if (ta->input_size != tb->input_size)
+    {
+        return (ta->input_size < tb->input_size) ? -1 : 1;
+    }
+
+    int ret = memcmp(ta->input, tb->input, ta->input_size);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    if (ta->output_size != tb->output_size)
+    {
+        return (ta->output_size < tb->output_size) ? -1 : 1;
+    }
+
+    return memcmp(ta->output, tb->output, ta->output_size);
+}
+
+/* Allocate a list of pointers to test cases in normalized order, so that the
+ * same set of test cases gives the same fingerprint regardless of order */
+static const evolution_testcase_t **_normalize(const evolution_testcase_t *testcases,
+                                               unsigned int num_testcases)
+{
+    const evolution_testcase_t **sorted = malloc(num_testcases * sizeof(evolution_testcase_t *));
+    if (NULL == sorted)
+    {
+        bfi_log("Failed to allocate memory");
+        return NULL;
+    }
+
+    for (unsigned int i = 0u; i < num_testcases; i++)
+    {
+        sorted[i] = &testcases[i];
+    }
+
+    qsort(sorted, num_testcases, sizeof(evolution_testcase_t *), _cmptestcases);
+    return sorted;
+}
+
+// Compute a fingerprint of test cases in normalized order
+static uint64_t _fingerprint(const evolution_testcase_t **sorted, unsigned int num_testcases)
+{
+    uint64_t hash = HASH_INIT;
+
+    for (unsigned int i = 0u; i < num_testcases; i++)
+    {
+        uint32_t sizes[2] = {(uint32_t) sorted[i]->input_size, (uint32_t) sorted[i]->output_size};
+        hash = hash_bytes(sizes, sizeof(sizes), hash);
+        hash = hash_bytes(sorted[i]->input, sorted[i]->input_size, hash);
+        hash = hash_bytes(sorted[i]->output, sorted[i]->output_size, hash);
+    }
+
+    return hash;
+}
+
+// Get the record at 'offset' in the mapped file, or NULL if there is no valid record there
+static const solution_record_t *_record_at(size_t offset)
+{
+    if ((_size < offset) || ((_size - offset) < sizeof(solution_record_t)))
+    {
+        return NULL;
+    }
+
+    const solution_record_t *record = (const solution_record_t *) (_data + offset);
+
+    if ((0u != (record->record_size % RECORD_ALIGN)) ||
+        (record->record_size > (_size - offset)) ||
+        (record->record_size < (sizeof(solution_record_t) + ((size_t) record->program_len) + 1u)))
+    {
+        return NULL;
+    }
+
+    // Program must be null-terminated
+    const char *program = (const char *) (record + 1);
+    if (0 != program[record->program_len])
+    {
+        return NULL;
+    }
+
+    return record;
+}
+
+/* Read a single test case stored in a record, and return a pointer to the next
+ * one, or NULL if the test case runs past 'end' */
+static const uint8_t *_read_testcase(const uint8_t *pos, const uint8_t *end, stored_testcase_t *testcase)
+{
+    uint32_t sizes[2];
+
+    if ((size_t) (end - pos) < sizeof(sizes))
+    {
+        return NULL;
+    }
+
+    memcpy(sizes, pos, sizeof(sizes));
+    pos += sizeof(sizes);
+
+    if ((size_t) (end - pos) < (((size_t) sizes[0]) + sizes[1]))
+    {
+        return NULL;
+    }
+
+    testcase->input = pos;
+    testcase->input_size = sizes[0];
+    testcase->output = pos + sizes[0];
+    testcase->output_size = sizes[1];
+
+    return pos + sizes[0] + sizes[1];
+}
+
+// Returns true if a stored test case has the same input as a test case
+static bool _same_input(const stored_testcase_t *stored, const evolution_testcase_t *testcase)
+{
+    return (stored->input_size == testcase->input_size) &&
+           (0 == memcmp(stored->input, testcase->input, testcase->input_size));
+}
+
+// Returns true if a record holds exactly the same test cases, in normalized order
+static bool _same_testcases(const solution_record_t *record, const evolution_testcase_t **sorted,
+                            unsigned int num_testcases)
+{
+    const uint8_t *end = ((const uint8_t *) record) + record->record_size;
+    const uint8_t *pos = ((const uint8_t *) (record + 1)) + record->program_len + 1u;
+
+    if (record->num_testcases != num_testcases)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0u; i < num_testcases; i++)
+    {
+        stored_testcase_t stored;
+
+        pos = _read_testcase(pos, end, &stored);
+        if ((NULL == pos) || !_same_input(&stored, sorted[i]) ||
+            (stored.output_size != sorted[i]->output_size) ||
+            (0 != memcmp(stored.output, sorted[i]->output, stored.output_size)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Similarity of a record to a set of test cases; for each test case, the length
+ * of the longest output prefix shared with a stored test case with the same input */
+static uint32_t _similarity(const solution_record_t *record, const evolution_testcase_t *testcases,
+                            unsigned int num_testcases)
+{
+    const uint8_t *end = ((const uint8_t *) record) + record->record_size;
+    const uint8_t *start = ((const uint8_t *) (record + 1)) + record->program_len + 1u;
+    uint32_t score = 0u;
+
+    for (unsigned int i = 0u; i < num_testcases; i++)
+    {
+        const uint8_t *pos = start;
+        uint32_t best = 0u;
+
+        for (uint32_t j = 0u; j < record->num_testcases; j++)
+        {
+            stored_testcase_t stored;
+
+            pos = _read_testcase(pos, end, &stored);
+            if (NULL == pos)
+            {
+                return 0u;
+            }
+
+            if (_same_input(&stored, &testcases[i]))
+            {
+                uint32_t len = 0u;
+                uint32_t max_len = MIN_VAL(stored.output_size, (uint32_t) testcases[i].output_size);
+
+                while ((len < max_len) && (stored.output[len] == (uint8_t) testcases[i].output[len]))
+                {
+                    len++;
+                }
+
+                best = MAX_VAL(best, len);
+            }
+        }
+
+        score += best;
+    }
+
+    return score;
+}
+
+/**
+ * @see solution_cache.h
+ */
+int solution_cache_open(const char *path)
+{
+    _data = map_file(path, &_size);
+
+    if (NULL == _data)
+    {
+        // Nothing stored yet
+        _size = 0u;
+        return 0;
+    }
+
+    const solution_cache_header_t *header = (const solution_cache_header_t *) _data;
+
+    if ((_size < sizeof(solution_cache_header_t)) ||
+        (0 != memcmp(header->magic, SOLUTION_CACHE_MAGIC, sizeof(header->magic))) ||
+        (SOLUTION_CACHE_VERSION != header->version))
+    {
+        bfi_log("%s is not a valid solution cache file", path);
+        solution_cache_close();
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @see solution_cache.h
+ */
+const char *solution_cache_find(const evolution_testcase_t *testcases, unsigned int num_testcases)
+{
+    if (NULL == _data)
+    {
+        return NULL;
+    }
+
+    const evolution_testcase_t **sorted = _normalize(testcases, num_testcases);
+    if (NULL == sorted)
+    {
+        return NULL;
+    }
+
+    uint64_t fingerprint = _fingerprint(sorted, num_testcases);
+    const solution_record_t *best = NULL;
+    const solution_record_t *record;
+
+    for (size_t offset = sizeof(solution_cache_header_t);
+         NULL != (record = _record_at(offset));
+         offset += record->record_size)
+    {
+        if ((fingerprint == record->fingerprint) &&
+            ((NULL == best) || (record->program_len < best->program_len)) &&
+            _same_testcases(record, sorted, num_testcases))
+        {
+            best = record;
+        }
+    }
+
+    free(sorted);
+    return (NULL == best) ? NULL : (const char *) (best + 1);
+}
+
+/**
+ * @see solution_cache.h
+ */
+unsigned int solution_cache_nearest(const evolution_testcase_t *testcases, unsigned int num_testcases,
+                                    const char **programs, unsigned int max_programs)
+{
+    if ((NULL == _data) || (0u == max_programs))
+    {
+        return 0u;
+    }
+
+    uint32_t *scores = malloc(max_programs * sizeof(uint32_t));
+    if (NULL == scores)
+    {
+        bfi_log("Failed to allocate memory");
+        return 0u;
+    }
+
+    unsigned int count = 0u;
+    const solution_record_t *record;
+
+    for (size_t offset = sizeof(solution_cache_header_t);
+         NULL != (record = _record_at(offset));
+         offset += record->record_size)
+    {
+        uint32_t score = _similarity(record, testcases, num_testcases);
+        if ((0u == score) || ((count == max_programs) && (score <= scores[count - 1u])))
+        {
+            continue;
+        }
+
+        // Insert into the list, which is sorted by score, highest first
+        unsigned int i = MIN_VAL(count, max_programs - 1u);
+        for (; (0u < i) && (scores[i - 1u] < score); i--)
+        {
+            scores[i] = scores[i - 1u];
+            programs[i] = programs[i - 1u];
+        }
+
+        scores[i] = score;
+        programs[i] = (const char *) (record + 1);
+        count = MIN_VAL(count + 1u, max_programs);
+    }
+
+    free(scores);
+    return count;
+}
+
+/**
+ * @see solution_cache.h
+ */
+void solution_cache_close(void)
+{
+    unmap_file(_data, _size);
+    _data = NULL;
+    _size = 0u;
+}
+
+/**
+ * @see solution_cache.h
+ */
+int solution_cache_store(const char *path, const evolution_testcase_t *testcases,
+                         unsigned int num_testcases, const char *program)
+{
+    static const uint8_t zeros[RECORD_ALIGN] = {0};
+
+    const evolution_testcase_t **sorted = _normalize(testcases, num_testcases);
+    if (NULL == sorted)
+    {
+        return -1;
+    }
+
+    solution_record_t record;
+    size_t size = sizeof(record) + strlen(program) + 1u;
+
+    for (unsigned int i = 0u; i < num_testcases; i++)
+    {
+        size += (2u * sizeof(uint32_t)) + sorted[i]->input_size + sorted[i]->output_size;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.fingerprint = _fingerprint(sorted, num_testcases);
+    record.record_size = (uint32_t) (((size + RECORD_ALIGN - 1u) / RECORD_ALIGN) * RECORD_ALIGN);
+    record.num_testcases = num_testcases;
+    record.program_len = (uint32_t) strlen(program);
+
+    FILE *fp = fopen(path, "ab");
+    if (NULL == fp)
+    {
+        bfi_log("Failed to open %s for writing", path);
+        free(sorted);
+        return -1;
+    }
+
+    bool failed = (0 != fseek(fp, 0, SEEK_END));
+
+    if (!failed && (0 == ftell(fp)))
+    {
+        // New file, write the header first
+        solution_cache_header_t header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SOLUTION_CACHE_MAGIC, sizeof(header.magic));
+        header.version = SOLUTION_CACHE_VERSION;
+
+        failed = (1u != fwrite(&header, sizeof(header), 1u, fp));
+    }
+
+    failed = failed || (1u != fwrite(&record, sizeof(record), 1u, fp)) ||
+             (1u != fwrite(program, record.program_len + 1u, 1u, fp));
+
+    for (unsigned int i = 0u; (i < num_testcases) && !failed; i++)
+    {
+        uint32_t sizes[2] = {(uint32_t) sorted[i]->input_size, (uint32_t) sorted[i]->output_size};
+
+        failed = (1u != fwrite(sizes, sizeof(sizes), 1u, fp)) ||
+                 (sizes[0] != fwrite(sorted[i]->input, 1u, sizes[0], fp)) ||
+                 (sizes[1] != fwrite(sorted[i]->output, 1u, sizes[1], fp));
+    }
+
+    failed = failed || ((record.record_size - size) != fwrite(zeros, 1u, record.record_size - size, fp));
+    failed = (0 != fclose(fp)) || failed;
+
+    free(sorted);
+
+    if (failed)
+    {
+        bfi_log("Failed to write solution to %s", path);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#ifndef SOLUTION_CACHE_H
+#define SOLUTION_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "evolution.h"
+
+
+#define SOLUTION_CACHE_MAGIC    "BFISOLN"
+#define SOLUTION_CACHE_VERSION  (1u)
+
+
+/**
+ * Header at the start of a solution cache file
+ */
+typedef struct
+{
+    // Must be SOLUTION_CACHE_MAGIC, including the null terminator
+    char magic[8];
+
+    // Must be SOLUTION_CACHE_VERSION
+    uint32_t version;
+
+    // Unused, keeps the header size a multiple of 8 bytes
+    uint32_t reserved;
+} solution_cache_header_t;
+
+
+/**
+ * Header of a single solution in a solution cache file. Followed by the
+ * null-terminated BF program, and then by the test cases that it passes, in
+ * normalized order, each one stored as a 32-bit input size, a 32-bit output size,
+ * input data and output data. Padded up to the next multiple of 8 bytes.
+ */
+typedef struct
+{
+    // Fingerprint of the normalized test cases
+    uint64_t fingerprint;
+
+    // Total size of this record in bytes, including this header and padding
+    uint32_t record_size;
+
+    // Number of test cases stored in this record
+    uint32_t num_testcases;
+
+    // Length of the BF program, not including the null terminator
+    uint32_t program_len;
+
+    // Unused, keeps the header size a multiple of 8 bytes
+    uint32_t reserved;
+} solution_record_t;
+
+
+/**
+ * Map a solution cache file into memory. A file that does not exist yet is
+ * treated as an empty cache.
+ *
+ * @param path  path of solution cache file
+ *
+ * @return 0 if successful, -1 if the file exists but is not a valid solution cache
+ */
+int solution_cache_open(const char *path);
+
+/**
+ * Find the shortest stored solution for exactly the same set of test cases, in
+ * any order.
+ *
+ * @param testcases      pointer to list of test cases
+ * @param num_testcases  number of test cases in the list
+ *
+ * @return pointer to the null-terminated BF program (valid until
+ *         solution_cache_close is called), or NULL if there is none
+ */
+const char *solution_cache_find(const evolution_testcase_t *testcases, unsigned int num_testcases);
+
+/**
+ * Find stored solutions for similar sets of test cases, ranked by the total
+ * length of output prefixes shared with the provided test cases, for test cases
+ * that have the same input.
+ *
+ * @param testcases      pointer to list of test cases
+ * @param num_testcases  number of test cases in the list
+ * @param programs       location to store pointers to null-terminated BF
+ *                       programs (valid until solution_cache_close is called),
+ *                       most similar first
+ * @param max_programs   max. number of pointers to write to 'programs'
+ *
+ * @return number of pointers written to 'programs'
+ */
+unsigned int solution_cache_nearest(const evolution_testcase_t *testcases, unsigned int num_testcases,
+                                    const char **programs, unsigned int max_programs);
+
+/**
+ * Unmap the solution cache file
+ */
+void solution_cache_close(void);
+
+/**
+ * Append a solution to a solution cache file, creating the file if it does not
+ * exist. Must not be called while the file is open with solution_cache_open.
+ *
+ * @param path           path of solution cache file
+ * @param testcases      pointer to list of test cases that the BF program passes
+ * @param num_testcases  number of test cases in the list
+ * @param program        null-terminated BF program
+ *
+ * @return 0 if successful, -1 if an error occurred
+ */
+int solution_cache_store(const char *path, const evolution_testcase_t *testcases,
+                         unsigned int num_testcases, const char *program);
+
+#endif // SOLUTION_CACHE_H
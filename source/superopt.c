@@ -0,0 +1,473 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "bf_utils.h"
+#include "common.h"
+#include "superopt.h"
+
+
+// Max. number of candidates of a single length that are kept for extending
+#define MAX_CANDIDATES (1u << 20)
+
+#define NUM_SYMS (8u)
+
+
+/**
+ * Holds everything needed for a single search
+ */
+typedef struct
+{
+    const evolution_testcase_t *testcases;
+    unsigned int num_testcases;
+
+    // BF program that windows are being replaced in, or NULL when searching for a complete BF program
+    const char *program;
+    size_t program_len;
+
+    // Index of the first character of the window being replaced, and max. window size
+    size_t window_start;
+    size_t max_window;
+
+    // Interpreter state, input position and output position of each test case at window_start
+    bf_state_t *states;
+    size_t *input_pos;
+    size_t *output_pos;
+
+    // Hashes of the interpreter states reached by candidates so far. 0 marks an empty slot.
+    uint64_t *seen;
+    size_t seen_size;
+    size_t seen_count;
+
+    // Candidates of the current length, and of the next length
+    char *levels[2];
+    size_t stride;
+    size_t capacity;
+
+    // Complete BF program that was last checked
+    char *text;
+
+    // Output buffer, with room for the longest expected output
+    char *output;
+
+    bf_state_t end_state;
+    uint64_t num_bf_programs;
+
+    // Set if some candidates were not tried, because there were too many
+    bool truncated;
+} search_t;
+
+
+static const char *_syms = "+-<>[].,";
+
+
+// Returns true if symbol 'b' right after symbol 'a' cancels it out, or loops forever
+static bool _cancels(char a, char b)
+{
+    return (('+' == a) && ('-' == b)) || (('-' == a) && ('+' == b)) ||
+           (('<' == a) && ('>' == b)) || (('>' == a) && ('<' == b)) ||
+           (('[' == a) && (']' == b));
+}
+
+// Returns loop depth at the end of a sequence of BF symbols, or -1 if a ']' has no matching '['
+static int _depth(const char *text, size_t len)
+{
+    int depth = 0;
+
+    for (size_t i = 0u; i < len; i++)
+    {
+        depth += ('[' == text[i]) - (']' == text[i]);
+        if (0 > depth)
+        {
+            return -1;
+        }
+    }
+
+    return depth;
+}
+
+static void _free_search(search_t *s)
+{
+    free(s->states);
+    free(s->input_pos);
+    free(s->output_pos);
+    free(s->seen);
+    free(s->levels[0]);
+    free(s->levels[1]);
+    free(s->text);
+    free(s->output);
+}
+
+static int _init_search(search_t *s, const evolution_testcase_t *testcases, unsigned int num_testcases,
+                        const char *program, size_t max_len)
+{
+    memset(s, 0, sizeof(*s));
+
+    s->testcases = testcases;
+    s->num_testcases = num_testcases;
+    s->program = program;
+    s->program_len = (NULL == program) ? 0u : strlen(program);
+    s->stride = max_len + 1u;
+
+    // No more than NUM_SYMS^max_len candidates of a single length
+    s->capacity = 1u;
+    for (size_t i = 0u; (i < max_len) && (s->capacity < MAX_CANDIDATES); i++)
+    {
+        s->capacity *= NUM_SYMS;
+    }
+
+    s->capacity = MIN_VAL(s->capacity, MAX_CANDIDATES);
+
+    s->seen_size = 1u;
+    while (s->seen_size < (s->capacity * 2u))
+    {
+        s->seen_size <<= 1u;
+    }
+
+    s->states = calloc(num_testcases, sizeof(bf_state_t));
+    s->input_pos = calloc(num_testcases, sizeof(size_t));
+    s->output_pos = calloc(num_testcases, sizeof(size_t));
+    s->seen = malloc(s->seen_size * sizeof(uint64_t));
+    s->levels[0] = malloc(s->capacity * s->stride);
+    s->levels[1] = malloc(s->capacity * s->stride);
+    s->text = malloc(MAX_VAL(s->program_len, max_len) + 1u);
+
+    size_t max_output_size = 0u;
+    for (unsigned int t = 0u; t < num_testcases; t++)
+    {
+        max_output_size = MAX_VAL(max_output_size, testcases[t].output_size);
+    }
+
+    s->output = malloc(max_output_size + 1u);
+
+    if ((NULL == s->states) || (NULL == s->input_pos) || (NULL == s->output_pos) ||
+        (NULL == s->seen) || (NULL == s->levels[0]) || (NULL == s->levels[1]) || (NULL == s->text) ||
+        (NULL == s->output))
+    {
+        bfi_log("Failed to allocate memory");
+        _free_search(s);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Returns true if a complete BF program passes all test cases
+static bool _passes(search_t *s, char *text)
+{
+    s->num_bf_programs++;
+
+    for (unsigned int t = 0u; t < s->num_testcases; t++)
+    {
+        const evolution_testcase_t *tc = &s->testcases[t];
+        char *output = s->output;
+
+        int len = bf_interpret(text, tc->input, tc->input_size, output, tc->output_size,
+                               MAX_INSTRUCTIONS_EXEC);
+
+        if ((0 > len) || (((size_t) len) != tc->output_size) || (0 != memcmp(output, tc->output, len)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Run a candidate from the interpreter state at the start of the window, for
+ * each test case. Returns false if the candidate fails, or prints anything that
+ * is not expected. Otherwise, stores a hash of the interpreter states that the
+ * candidate leaves behind, and whether all expected output has been printed. */
+static bool _run_candidate(search_t *s, char *text, uint64_t *hash, bool *complete)
+{
+    s->num_bf_programs++;
+
+    *hash = HASH_INIT;
+    *complete = true;
+
+    for (unsigned int t = 0u; t < s->num_testcases; t++)
+    {
+        const evolution_testcase_t *tc = &s->testcases[t];
+        char *output = s->output;
+
+        int len = bf_interpret_ex(text, tc->input + s->input_pos[t],
+                                  tc->input_size - s->input_pos[t], output,
+                                  tc->output_size - s->output_pos[t], MAX_INSTRUCTIONS_EXEC,
+                                  &s->states[t], &s->end_state);
+
+        if ((0 > len) || (0 != memcmp(output, tc->output + s->output_pos[t], len)))
+        {
+            return false;
+        }
+
+        int sizes[4] = {len, bf_last_input_count(), s->end_state.pointer, s->end_state.tape_len};
+        *hash = hash_bytes(sizes, sizeof(sizes), *hash);
+        *hash = hash_bytes(s->end_state.tape, s->end_state.tape_len, *hash);
+
+        *complete = *complete && ((s->output_pos[t] + len) == tc->output_size);
+    }
+
+    return true;
+}
+
+// Returns true if the interpreter states with this hash were already reached by another candidate
+static bool _seen_before(search_t *s, uint64_t hash)
+{
+    // Stop pruning once the table is half full, rather than probing forever
+    if ((s->seen_count * 2u) >= s->seen_size)
+    {
+        return false;
+    }
+
+    hash |= 1u;
+    size_t i = hash & (s->seen_size - 1u);
+
+    while (0u != s->seen[i])
+    {
+        if (hash == s->seen[i])
+        {
+            return true;
+        }
+
+        i = (i + 1u) & (s->seen_size - 1u);
+    }
+
+    s->seen[i] = hash;
+    s->seen_count++;
+    return false;
+}
+
+/* Returns true if a candidate passes all test cases, in place of the largest
+ * possible window when replacing windows. The complete BF program is left in s->text. */
+static bool _accept(search_t *s, const char *candidate, size_t len, bool complete)
+{
+    if (NULL == s->program)
+    {
+        memcpy(s->text, candidate, len);
+        s->text[len] = 0;
+        return complete && (0u < len) && _passes(s, s->text);
+    }
+
+    size_t window = MIN_VAL(s->max_window, s->program_len - s->window_start);
+
+    for (; window > len; window--)
+    {
+        size_t window_end = s->window_start + window;
+
+        // Nothing after the last window to print the rest of the expected output
+        if ((!complete && (window_end == s->program_len)) ||
+            (0 != _depth(s->program + s->window_start, window)))
+        {
+            continue;
+        }
+
+        memcpy(s->text, s->program, s->window_start);
+        memcpy(s->text + s->window_start, candidate, len);
+        memcpy(s->text + s->window_start + len, s->program + window_end,
+               s->program_len - window_end + 1u);
+
+        if (_passes(s, s->text))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Try candidates in order of length, up to max_len characters, until one is
+ * accepted. Candidates outside of any loop are run, and are not extended any
+ * further if they fail or leave the same interpreter states as an earlier
+ * candidate. Returns the length of the accepted candidate, or -1 if none. */
+static int _search(search_t *s, size_t max_len)
+{
+    char *level = s->levels[0];
+    char *next = s->levels[1];
+    size_t count = 1u;
+
+    memset(s->seen, 0, s->seen_size * sizeof(uint64_t));
+    s->seen_count = 0u;
+
+    for (size_t len = 0u; (len <= max_len) && (0u < count); len++)
+    {
+        size_t next_count = 0u;
+
+        for (size_t c = 0u; c < count; c++)
+        {
+            char *candidate = level + (c * s->stride);
+            int depth = _depth(candidate, len);
+
+            if (0 == depth)
+            {
+                uint64_t hash;
+                bool complete;
+
+                candidate[len] = 0;
+
+                if (!_run_candidate(s, candidate, &hash, &complete) || _seen_before(s, hash))
+                {
+                    continue;
+                }
+
+                if (_accept(s, candidate, len, complete))
+                {
+                    return (int) len;
+                }
+            }
+
+            if (len == max_len)
+            {
+                continue;
+            }
+
+            char last = (0u < len) ? candidate[len - 1u] : 0;
+
+            for (unsigned int i = 0u; i < NUM_SYMS; i++)
+            {
+                int new_depth = depth + ('[' == _syms[i]) - (']' == _syms[i]);
+
+                // Skip loops that can't be closed within max_len characters
+                if (_cancels(last, _syms[i]) || (0 > new_depth) ||
+                    ((len + 1u + new_depth) > max_len))
+                {
+                    continue;
+                }
+
+                if (next_count == s->capacity)
+                {
+                    s->truncated = true;
+                    break;
+                }
+
+                char *extended = next + (next_count * s->stride);
+                memcpy(extended, candidate, len);
+                extended[len] = _syms[i];
+                next_count++;
+            }
+        }
+
+        char *tmp = level;
+        level = next;
+        next = tmp;
+        count = next_count;
+    }
+
+    return -1;
+}
+
+/* Save the interpreter state at a window start, by running the part of the BF
+ * program before it. Returns false if that part can't be run on its own. */
+static bool _start_window(search_t *s, size_t window_start)
+{
+    s->window_start = window_start;
+    s->num_bf_programs++;
+
+    memcpy(s->text, s->program, window_start);
+    s->text[window_start] = 0;
+
+    for (unsigned int t = 0u; t < s->num_testcases; t++)
+    {
+        const evolution_testcase_t *tc = &s->testcases[t];
+        char *output = s->output;
+
+        int len = bf_interpret_ex(s->text, tc->input, tc->input_size, output,
+                                  tc->output_size, MAX_INSTRUCTIONS_EXEC, NULL, &s->states[t]);
+        if (0 > len)
+        {
+            return false;
+        }
+
+        s->output_pos[t] = len;
+        s->input_pos[t] = bf_last_input_count();
+    }
+
+    return true;
+}
+
+/**
+ * @see superopt.h
+ */
+int superopt_search(const evolution_testcase_t *testcases, unsigned int num_testcases,
+                    size_t max_len, char *program, uint64_t *num_bf_programs)
+{
+    if ((NULL == testcases) || (NULL == program) || (NULL == num_bf_programs) ||
+        (0u == max_len) || (SUPEROPT_MAX_LEN < max_len))
+    {
+        return -1;
+    }
+
+    search_t s;
+    if (_init_search(&s, testcases, num_testcases, NULL, max_len) < 0)
+    {
+        return -1;
+    }
+
+    int len = _search(&s, max_len);
+    if (0 < len)
+    {
+        memcpy(program, s.text, len + 1);
+    }
+
+    if (s.truncated)
+    {
+        bfi_log("too many BF programs of up to %zu characters, not all of them were tried", max_len);
+    }
+
+    *num_bf_programs += s.num_bf_programs;
+
+    _free_search(&s);
+    return MAX_VAL(len, 0);
+}
+
+/**
+ * @see superopt.h
+ */
+int superopt_polish(const evolution_testcase_t *testcases, unsigned int num_testcases,
+                    size_t max_window, char *program, uint64_t *num_bf_programs)
+{
+    if ((NULL == testcases) || (NULL == program) || (NULL == num_bf_programs) ||
+        (2u > max_window) || (SUPEROPT_MAX_WINDOW < max_window))
+    {
+        return -1;
+    }
+
+    search_t s;
+    if (_init_search(&s, testcases, num_testcases, program, max_window - 1u) < 0)
+    {
+        return -1;
+    }
+
+    s.max_window = max_window;
+
+    int depth = 0;
+    size_t i = 0u;
+
+    while (i < s.program_len)
+    {
+        // Windows replaced at depth 0 contain complete loops only, so depth stays the same
+        if ((0 == depth) && _start_window(&s, i) && (0 <= _search(&s, max_window - 1u)))
+        {
+            s.program_len = strlen(s.text);
+            memcpy(program, s.text, s.program_len + 1u);
+            continue;
+        }
+
+        depth += ('[' == program[i]) - (']' == program[i]);
+        i++;
+    }
+
+    *num_bf_programs += s.num_bf_programs;
+
+    _free_search(&s);
+    return (int) s.program_len;
+}
@@ -0,0 +1,61 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#ifndef SUPEROPT_H
+#define SUPEROPT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "evolution.h"
+
+
+// Max. BF program length that superopt_search can search up to
+#define SUPEROPT_MAX_LEN     (16u)
+
+// Max. window size for superopt_polish
+#define SUPEROPT_MAX_WINDOW  (6u)
+
+
+/**
+ * Search exhaustively for the shortest BF program that passes all test cases.
+ * BF programs are tried in order of length, and BF programs that leave the
+ * interpreter in the same state as a shorter BF program (for all test cases)
+ * are not extended any further.
+ *
+ * @param testcases        pointer to list of test cases
+ * @param num_testcases    number of test cases in the list
+ * @param max_len          max. length of BF programs to search, up to SUPEROPT_MAX_LEN
+ * @param program          location to store the null-terminated BF program, must
+ *                         have room for max_len + 1 characters
+ * @param num_bf_programs  pointer to counter, incremented for each BF program executed
+ *
+ * @return length of the BF program found, 0 if there is no BF program of up to
+ *         max_len characters that passes all test cases, or -1 if an error occurred
+ */
+int superopt_search(const evolution_testcase_t *testcases, unsigned int num_testcases,
+                    size_t max_len, char *program, uint64_t *num_bf_programs);
+
+/**
+ * Shorten a BF program that passes all test cases, by replacing windows of up
+ * to max_window characters with the shortest sequence of BF symbols that still
+ * passes all test cases. Only windows outside of any loop, containing complete
+ * loops only, are replaced.
+ *
+ * @param testcases        pointer to list of test cases
+ * @param num_testcases    number of test cases in the list
+ * @param max_window       max. number of characters in a window, up to SUPEROPT_MAX_WINDOW
+ * @param program          null-terminated BF program, shortened in place
+ * @param num_bf_programs  pointer to counter, incremented for each BF program executed
+ *
+ * @return new length of the BF program, or -1 if an error occurred
+ */
+int superopt_polish(const evolution_testcase_t *testcases, unsigned int num_testcases,
+                    size_t max_window, char *program, uint64_t *num_bf_programs);
+
+#endif // SUPEROPT_H
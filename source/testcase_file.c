@@ -0,0 +1,123 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "testcase_file.h"
+
+
+static const uint8_t *_data = NULL;
+static size_t _size = 0u;
+static unsigned int _num_testcases = 0u;
+
+
+/* Read the sizes of the test case at 'pos', and return a pointer to the next
+ * one, or NULL if the test case runs past the end of the file */
+static const uint8_t *_read_sizes(const uint8_t *pos, uint32_t sizes[2])
+{
+    const uint8_t *end = _data + _size;
+
+    if ((size_t) (end - pos) < (2u * sizeof(uint32_t)))
+    {
+        return NULL;
+    }
+
+    // Sizes may not be aligned
+    memcpy(sizes, pos, 2u * sizeof(uint32_t));
+    pos += 2u * sizeof(uint32_t);
+
+    if ((size_t) (end - pos) < (((size_t) sizes[0]) + sizes[1]))
+    {
+        return NULL;
+    }
+
+    return pos + sizes[0] + sizes[1];
+}
+
+/**
+ * @see testcase_file.h
+ */
+int testcase_file_open(const char *path)
+{
+    _data = map_file(path, &_size);
+
+    if (NULL == _data)
+    {
+        bfi_log("Failed to open %s for reading", path);
+        return -1;
+    }
+
+    const testcase_file_header_t *header = (const testcase_file_header_t *) _data;
+
+    if ((_size < sizeof(testcase_file_header_t)) ||
+        (0 != memcmp(header->magic, TESTCASE_FILE_MAGIC, sizeof(header->magic))) ||
+        (TESTCASE_FILE_VERSION != header->version) || (0u == header->num_testcases) ||
+        (INT32_MAX < header->num_testcases))
+    {
+        bfi_log("%s is not a valid test case file", path);
+        testcase_file_close();
+        return -1;
+    }
+
+    // Check all sizes up front, so that testcase_file_read can't fail
+    const uint8_t *pos = _data + sizeof(testcase_file_header_t);
+    for (uint32_t i = 0u; i < header->num_testcases; i++)
+    {
+        uint32_t sizes[2];
+
+        pos = _read_sizes(pos, sizes);
+        if (NULL == pos)
+        {
+            bfi_log("%s is truncated, test case #%u is incomplete", path, i + 1u);
+            testcase_file_close();
+            return -1;
+        }
+    }
+
+    _num_testcases = header->num_testcases;
+    return (int) _num_testcases;
+}
+
+/**
+ * @see testcase_file.h
+ */
+void testcase_file_read(evolution_testcase_t *testcases)
+{
+    const uint8_t *pos = _data + sizeof(testcase_file_header_t);
+
+    for (unsigned int i = 0u; i < _num_testcases; i++)
+    {
+        uint32_t sizes[2];
+
+        // Sizes were already checked by testcase_file_open
+        memcpy(sizes, pos, sizeof(sizes));
+        pos += sizeof(sizes);
+
+        testcases[i].input = (const char *) pos;
+        testcases[i].input_size = sizes[0];
+        testcases[i].output = (const char *) pos + sizes[0];
+        testcases[i].output_size = sizes[1];
+
+        pos += sizes[0] + sizes[1];
+    }
+}
+
+/**
+ * @see testcase_file.h
+ */
+void testcase_file_close(void)
+{
+    unmap_file(_data, _size);
+    _data = NULL;
+    _size = 0u;
+    _num_testcases = 0u;
+}
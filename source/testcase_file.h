@@ -0,0 +1,65 @@
+/**
+ * Brainfuck Intern (Erik Nyquist, 2023)
+ * <eknyquist@gmail.com>)
+ *
+ * Uses a genetic algorithm to generate poorly written Brainfuck programs
+ * that match user-provided test cases, by pure brute-force.
+ */
+
+#ifndef TESTCASE_FILE_H
+#define TESTCASE_FILE_H
+
+#include <stdint.h>
+
+#include "evolution.h"
+
+
+#define TESTCASE_FILE_MAGIC    "BFITEST"
+#define TESTCASE_FILE_VERSION  (1u)
+
+
+/**
+ * Header at the start of a test case file. Followed by num_testcases test cases,
+ * each one stored as a 32-bit input size, a 32-bit output size, input data and
+ * output data, with no padding. Sizes are stored in the byte order of the machine
+ * that reads the file, and input/output data may contain any byte values.
+ */
+typedef struct
+{
+    // Must be TESTCASE_FILE_MAGIC, including the null terminator
+    char magic[8];
+
+    // Must be TESTCASE_FILE_VERSION
+    uint32_t version;
+
+    // Number of test cases in the file
+    uint32_t num_testcases;
+} testcase_file_header_t;
+
+
+/**
+ * Map a test case file into memory, and check that it is valid
+ *
+ * @param path  path of test case file
+ *
+ * @return number of test cases in the file, or -1 if the file could not be
+ *         mapped or is not a valid test case file
+ */
+int testcase_file_open(const char *path);
+
+/**
+ * Point test cases at the input and output data in the mapped test case file.
+ * Nothing is copied, so the test cases are only valid until testcase_file_close
+ * is called.
+ *
+ * @param testcases  location to store test cases, must have room for as many
+ *                   test cases as returned by testcase_file_open
+ */
+void testcase_file_read(evolution_testcase_t *testcases);
+
+/**
+ * Unmap the test case file
+ */
+void testcase_file_close(void);
+
+#endif // TESTCASE_FILE_H